@@ -1,4 +1,7 @@
 #include "QOpenGL2DPlot.h"
+#include "QOpenGL2DPlotCapture.h"
+
+#include <QtConcurrent/QtConcurrentMap>
 
 #define MAX_FRAME_MARGIN            5
 #define MARGIN_REL_SIZE             0.05
@@ -24,10 +27,17 @@
 #define TOP_RIGHT_Y                 7
 
 #define DEFAULT_FRAME_COLOR         QColor(0,0,0,255)
+#define DEFAULT_TEXT_COLOR          QColor(0,0,0,255)
 #define DEFAULT_PLOT_COLOR          QColor(0,0,0,255)
 #define DEFAULT_GRID_COLOR          QColor(200,200,200,255)
 #define DEFAULT_SEC_GRID_COLOR      QColor(230,230,230,255)
 #define DEFAULT_PLOT_VISIBLE        true
+#define DEFAULT_PLOT_MARKER         QOpenGL2DPlot::NoMarker
+#define DEFAULT_MARKER_SIZE         5
+
+#define EXPORT_TICK_LENGTH          6
+#define EXPORT_SEC_TICK_LENGTH      3
+#define EXPORT_PANE_LIMIT           1E3
 
 #define DEFAULT_TOP_RANGE           10
 #define DEFAULT_BOT_RANGE           0
@@ -35,15 +45,58 @@
 #define DEFAULT_LOG_TOP_RANGE       10
 #define DEFAULT_LOG_BOT_RANGE       1E-1
 
+#define DEFAULT_MAX_FRAME_RATE      60
+
 #define DEFAULT_TICK_STEP           2
 #define DEFAULT_SEC_TICK_COUNT      4
 
+#define MIN_BUFFER_CAPACITY         1024
+#define BUFFER_GROWTH_FACTOR        2
+
+#define LOD_FACTOR                  4
+#define LOD_MIN_BUCKETS             512
+
+#define COLUMN_LOD_FACTOR           64
+#define COLUMN_CHUNK_SIZE           65535
+
+#define GEOMETRY_CHUNK_SIZE         (1 << 16)
+#define GEOMETRY_PARALLEL_MIN       (1 << 18)
+
+#define CAPTURE_WINDOW_SIZE         (1 << 20)
+
+#define GLYPH_ATLAS_WIDTH           512
+
+#define NO_STAGE                    -1
+#define GPU_QUERIES                 2
+
+// Desktop contexts only size points from the shader when asked to, and
+// compatibility contexts only texture them as sprites when asked to. ES
+// always does both.
+#ifndef GL_PROGRAM_POINT_SIZE
+#define GL_PROGRAM_POINT_SIZE       0x8642
+#endif
+#ifndef GL_POINT_SPRITE
+#define GL_POINT_SPRITE             0x8861
+#endif
+
 #define DEFAULT_TITLE               "Plot Title"
 #define DEFAULT_BOT_LABEL           "Bottom Label"
 #define DEFAULT_TOP_LABEL           "Top Label"
 #define DEFAULT_LEFT_LABEL          "Left Label"
 #define DEFAULT_RIGHT_LABEL         "Right Label"
 
+#define DIRTY_NONE                  0x00
+#define DIRTY_LAYOUT                0x01
+#define DIRTY_MATRICES              0x02
+#define DIRTY_GRID                  0x04
+#define DIRTY_TICKS                 0x08
+#define DIRTY_LABELS                0x10
+#define DIRTY_TEXT                  0x20
+#define DIRTY_DECORATIONS           0x40
+#define DIRTY_RANGES                (DIRTY_MATRICES | DIRTY_GRID | \
+                                     DIRTY_TICKS | DIRTY_LABELS)
+#define DIRTY_ALL                   0x7F
+
 #ifdef QT_DEBUG
 #define NO_ERRORS                   0x00
 #define PLOT_INDEX_ERROR            0x01
@@ -51,24 +104,117 @@
 #define LOG_RANGE_ERROR             0x04
 #define RANGE_ERROR                 0x08
 #define BUFFER_SIZE_ERROR           0x10
+#define PLOT_TYPE_ERROR             0x20
+#define CONTEXT_ERROR               0x40
 #endif
 
+// Data is relative to a per-plot origin. Linear axes fold the origin
+// into the matrix, logarithmic axes need the absolute value.
+#define LOG_AXIS_SOURCE \
+        "uniform highp vec2 origin;\n" \
+        "highp float logAxis(highp float v, highp float o,\n" \
+        "                    highp float lg, highp float fl) {\n" \
+        "   if (lg < 0.5) return v;\n" \
+        "   v += o;\n" \
+        "   if (v <= 0.0) return fl;\n" \
+        "   return log2(v)*0.30102999566;\n" \
+        "}\n"
+
 static const char vertexShaderSource[] =
         "attribute highp vec2 pos;\n"
         "uniform lowp vec4 col;\n"
         "uniform highp mat4 matrix;\n"
+        "uniform highp vec2 logscale;\n"
+        "uniform highp vec2 logfloor;\n"
+        "uniform mediump float pointsize;\n"
         "varying lowp vec4 FragColor;\n"
+        LOG_AXIS_SOURCE
         "void main() {\n"
-        "   gl_Position = matrix*vec4(pos,0.0,1.0);\n"
+        "   highp vec2 p = vec2(\n"
+        "       logAxis(pos.x,origin.x,logscale.x,logfloor.x),\n"
+        "       logAxis(pos.y,origin.y,logscale.y,logfloor.y));\n"
+        "   gl_Position = matrix*vec4(p,0.0,1.0);\n"
+        "   gl_PointSize = pointsize;\n"
         "   FragColor = col;\n"
         "}\n";
 
+// Typed sample columns. xval is either an X column or a sample index,
+// xmap turns it into x = xmap.x+xval*xmap.y.
+static const char columnVertexSource[] =
+        "attribute highp float xval;\n"
+        "attribute highp float yval;\n"
+        "uniform lowp vec4 col;\n"
+        "uniform highp mat4 matrix;\n"
+        "uniform highp vec2 xmap;\n"
+        "uniform highp vec2 logscale;\n"
+        "uniform highp vec2 logfloor;\n"
+        "uniform mediump float pointsize;\n"
+        "varying lowp vec4 FragColor;\n"
+        LOG_AXIS_SOURCE
+        "void main() {\n"
+        "   highp float x = xmap.x+xval*xmap.y;\n"
+        "   highp vec2 p = vec2(\n"
+        "       logAxis(x,origin.x,logscale.x,logfloor.x),\n"
+        "       logAxis(yval,origin.y,logscale.y,logfloor.y));\n"
+        "   gl_Position = matrix*vec4(p,0.0,1.0);\n"
+        "   gl_PointSize = pointsize;\n"
+        "   FragColor = col;\n"
+        "}\n";
+
+// Markers are point sprites cut to shape from gl_PointCoord, marker is
+// a QOpenGL2DPlot::Marker and 0 draws plain lines.
 static const char vertexFragmentSource[] =
+        "uniform mediump float marker;\n"
         "varying lowp vec4 FragColor;\n"
         "void main() {\n"
+        "   if (marker > 0.5) {\n"
+        "       mediump vec2 p = gl_PointCoord*2.0-1.0;\n"
+        "       if (marker < 1.5) {\n"
+        "           if (dot(p,p) > 1.0) discard;\n"
+        "       } else if (marker > 2.5 && marker < 3.5) {\n"
+        "           if (min(abs(p.x),abs(p.y)) > 0.2) discard;\n"
+        "       } else if (marker > 3.5) {\n"
+        "           if (abs(p.x) > 0.5*(p.y+1.0)) discard;\n"
+        "       }\n"
+        "   }\n"
         "   gl_FragColor = FragColor;\n"
         "}\n";
 
+static const char textVertexSource[] =
+        "attribute highp vec2 pos;\n"
+        "attribute mediump vec2 tex;\n"
+        "uniform highp mat4 matrix;\n"
+        "varying mediump vec2 TexCoord;\n"
+        "void main() {\n"
+        "   gl_Position = matrix*vec4(pos,0.0,1.0);\n"
+        "   TexCoord = tex;\n"
+        "}\n";
+
+static const char textFragmentSource[] =
+        "uniform sampler2D atlas;\n"
+        "uniform lowp vec4 col;\n"
+        "varying mediump vec2 TexCoord;\n"
+        "void main() {\n"
+        "   gl_FragColor = col*texture2D(atlas,TexCoord).a;\n"
+        "}\n";
+
+// Cached decoration layers cover the whole viewport, pos is already in
+// texture space.
+static const char layerVertexSource[] =
+        "attribute highp vec2 pos;\n"
+        "varying mediump vec2 TexCoord;\n"
+        "void main() {\n"
+        "   gl_Position = vec4(pos*2.0-1.0,0.0,1.0);\n"
+        "   TexCoord = pos;\n"
+        "}\n";
+
+static const char layerFragmentSource[] =
+        "uniform sampler2D layer;\n"
+        "varying mediump vec2 TexCoord;\n"
+        "void main() {\n"
+        "   gl_FragColor = texture2D(layer,TexCoord);\n"
+        "}\n";
+
 #ifdef QT_DEBUG
 typedef int Error;
 
@@ -111,6 +257,18 @@ void ErrorHandle(Error error)
                             "exceeded\n");
     }
 
+    if (error & PLOT_TYPE_ERROR)
+    {
+        error_string.append("QOpenGL2DPlot: Plot does not hold "
+                            "samples of this layout.\n");
+    }
+
+    if (error & CONTEXT_ERROR)
+    {
+        error_string.append("QOpenGL2DPlot: Plot is already set up "
+                            "in another context.\n");
+    }
+
     try {
         if (error_string.length())
         {
@@ -134,10 +292,9 @@ void CheckPlotIndex(int plot_index,
     }
 }
 
-void CheckIndex(int index, const QVector<QPointF> &data,
-                Error &error)
+void CheckIndex(int index, int count, Error &error)
 {
-    if (index >= data.count())
+    if (index >= count)
     {
         error |= INDEX_ERROR;
     }
@@ -160,6 +317,65 @@ void CheckLogRange(double range, Error &error)
 }
 #endif // QT_DEBUG
 
+// Min/max pyramid of a plot with sorted X. Level k (stored at k-1) has
+// one bucket per LOD_FACTOR^k points and keeps the lowest and highest
+// point of each bucket, in index order, so spikes survive decimation.
+struct PlotLodStruct {
+    QVector<QVector<QPointF>> levels;
+    QVector<int> dirty;
+    QVector<QOpenGLBuffer> buffers;
+    QVector<QOpenGLVertexArrayObject*> vaos;
+    QVector<int> capacity;
+};
+
+// Typed samples of a plot kept as separate columns in their own type.
+// Without an X column, X is x0+i*dt and is generated in the vertex
+// shader from a shared sample index buffer. External views read the
+// caller's memory through y_data/x_data with a byte stride.
+struct PlotColumnStruct {
+    QOpenGL2DPlot::SampleType y_type;
+    QOpenGL2DPlot::SampleType x_type;
+    bool implicit_x;
+    bool external;
+    QByteArray y;
+    QByteArray x;
+    const char *y_data;
+    const char *x_data;
+    int y_stride;
+    int x_stride;
+    int count;
+    double x0;
+    double dt;
+    QOpenGLBuffer y_buffer;
+    QOpenGLBuffer x_buffer;
+};
+
+// Glyphs of one font size rasterized once into a texture. Texture
+// coordinates are in image space, the first image row is at t = 0.
+struct GlyphAtlasStruct {
+    QOpenGLTexture *texture;
+    QString glyphs;
+    QHash<QChar,QRectF> tex_rect;
+    QHash<QChar,int> advance;
+    int height;
+};
+
+// Window of a capture file a column plot currently views. Ranges are in
+// capture samples, the view reads level "level" of the summary.
+struct PlotCaptureStruct {
+    QOpenGL2DPlotCapture *capture;
+    int column;
+    int level;
+    qint64 from;
+    qint64 to;
+};
+
+struct TextRangeStruct {
+    int size;
+    int first;
+    int count;
+};
+
 struct PlotDataStruct {
     QPainter painter;
     QRect viewport;
@@ -171,6 +387,11 @@ struct PlotDataStruct {
     GLint pos;
     GLint col;
     GLint mat;
+    GLint log;
+    GLint log_floor;
+    GLint origin;
+    GLint marker;
+    GLint point_size;
 
     QOpenGLShaderProgram m_program;
     QOpenGLBuffer frame_pos_buffer;
@@ -178,8 +399,57 @@ struct PlotDataStruct {
     QOpenGLVertexArrayObject frame_vao;
     QColor frame_color;
 
+    QOpenGLShaderProgram column_program;
+    GLint column_x;
+    GLint column_y;
+    GLint column_col;
+    GLint column_mat;
+    GLint column_xmap;
+    GLint column_log;
+    GLint column_log_floor;
+    GLint column_origin;
+    GLint column_marker;
+    GLint column_point_size;
+    QOpenGLBuffer column_index_buffer;
+
+    QOpenGLShaderProgram text_program;
+    GLint text_pos;
+    GLint text_tex;
+    GLint text_col;
+    GLint text_mat;
+    QOpenGLBuffer text_buffer;
+    QOpenGLVertexArrayObject text_vao;
+    QHash<int,GlyphAtlasStruct*> glyph_atlas;
+    QVector<TextRangeStruct> text_ranges;
+    QColor text_color;
+
+    QOpenGLShaderProgram layer_program;
+    GLint layer_pos;
+    QOpenGLBuffer layer_buffer;
+    QOpenGLVertexArrayObject layer_vao;
+    QOpenGLFramebufferObject *under_layer;
+    QOpenGLFramebufferObject *over_layer;
+
+    uint dirty;
+
+    double max_frame_rate;
+    QTimer frame_timer;
+    QElapsedTimer frame_clock;
+
+    bool stats_enabled;
+    int stats_stage;
+    qint64 stats_mark;
+    QOpenGL2DPlot::FrameStats stats;
+    QOpenGL2DPlot::FrameStats last_stats;
+    QVector<double> stats_history[QOpenGL2DPlot::StageCount];
+    int stats_window;
+    int stats_frames;
+    QOpenGLTimerQuery *gpu_query[GPU_QUERIES];
+    bool gpu_query_pending[GPU_QUERIES];
+    int gpu_query_next;
+
     QMatrix4x4 matrix;
-    QMatrix4x4 data_matrix;
+    QMatrix4x4 pane_matrix;
     QMatrix4x4 grid_matrix;
 
     QRect plot_pane;
@@ -207,11 +477,30 @@ struct PlotDataStruct {
 
     QVector<QVector<QPointF>> data;
     QVector<QOpenGLBuffer> data_pos_buffer;
-    QVector<QOpenGLBuffer> data_index_buffer;
     QVector<QOpenGLVertexArrayObject*> data_vao;
+    QVector<int> data_capacity;
+    QVector<int> data_dirty_begin;
+    QVector<int> data_dirty_end;
+    QVector<int> ring_capacity;
+    QVector<int> ring_start;
+    QVector<int> ring_count;
+    QVector<int> ring_pending;
+    QVector<bool> data_sorted;
+    QVector<PlotLodStruct*> data_lod;
+    QVector<QOpenGL2DPlotProducer*> data_producer;
+    QVector<PlotColumnStruct*> data_column;
+    QVector<PlotCaptureStruct*> data_capture;
+    QVector<QPointF> data_origin;
+    QVector<int> data_marker;
+    QVector<GLfloat> data_marker_size;
     QVector<bool> data_visible;
     QVector<QColor> data_color;
 
+    // GL objects dropped by setters, destroyed on the owning context at
+    // the next frame
+    QVector<QOpenGLBuffer> released_buffers;
+    QVector<QOpenGLVertexArrayObject*> released_vaos;
+
     double tick_step[4];
     uint ticks_count[4];
     uint sec_ticks_count[4];
@@ -239,13 +528,88 @@ struct PlotDataStruct {
     double y_offset;
 };
 
-void SetFrameSize(PlotDataStruct *plot_data,
-                  const QRect &viewport)
-{    
+void ClearFrameStats(QOpenGL2DPlot::FrameStats &stats)
+{
+    for (int i = 0; i < QOpenGL2DPlot::StageCount; i++)
+    {
+        stats.time[i] = 0;
+    }
+
+    stats.time[QOpenGL2DPlot::GpuStage] = -1;
+    stats.vertices        = 0;
+    stats.draw_calls      = 0;
+    stats.bytes_uploaded  = 0;
+    stats.points_ingested = 0;
+}
+
+// Charges the time since the last switch to the stage that was running
+// and returns it, so nested work can switch back. The clock is only read
+// while statistics are enabled.
+int EnterStage(PlotDataStruct *plot_data, int stage)
+{
+    if (!plot_data->stats_enabled)
+    {
+        return stage;
+    }
+
+    qint64 now = plot_data->frame_clock.nsecsElapsed();
+    int previous = plot_data->stats_stage;
+
+    if (previous != NO_STAGE)
+    {
+        plot_data->stats.time[previous] += (now-plot_data->stats_mark)*1E-9;
+    }
+
+    plot_data->stats_stage = stage;
+    plot_data->stats_mark  = now;
+
+    return previous;
+}
+
+void CountDraw(PlotDataStruct *plot_data, qint64 vertices)
+{
+    if (plot_data->stats_enabled)
+    {
+        plot_data->stats.draw_calls++;
+        plot_data->stats.vertices += vertices;
+    }
+}
+
+void CountUpload(PlotDataStruct *plot_data, qint64 bytes)
+{
+    if (plot_data->stats_enabled)
+    {
+        plot_data->stats.bytes_uploaded += bytes;
+    }
+}
+
+void CountPoints(PlotDataStruct *plot_data, qint64 count)
+{
+    if (plot_data->stats_enabled)
+    {
+        plot_data->stats.points_ingested += count;
+    }
+}
+
+void WriteBuffer(PlotDataStruct *plot_data, QOpenGLBuffer *buffer,
+                 int offset, const void *data, int count)
+{
+    int stage = EnterStage(plot_data,QOpenGL2DPlot::UploadStage);
+
+    buffer->write(offset,data,count);
+    CountUpload(plot_data,count);
+
+    EnterStage(plot_data,stage);
+}
+
+// Places the plot pane and the title and label rects in viewport
+void SetFrameLayout(PlotDataStruct *plot_data, const QRect &viewport)
+{
     plot_data->matrix.setToIdentity();
     plot_data->matrix.ortho(viewport);
 
     plot_data->viewport = viewport;
+    plot_data->dirty |= DIRTY_TEXT;
 
     GLfloat pos[8];
     QFont font;
@@ -358,19 +722,6 @@ void SetFrameSize(PlotDataStruct *plot_data,
 
     plot_data->plot_pane = QRect(top_left,bottom_right);
 
-    QOpenGLVertexArrayObject::Binder vao_binder(&(plot_data->frame_vao));
-    {
-        plot_data->m_program.enableAttributeArray(plot_data->pos);
-
-        plot_data->frame_pos_buffer.bind();
-        plot_data->frame_pos_buffer.allocate(pos,8*sizeof(GLfloat));
-        plot_data->m_program.setAttributeBuffer(plot_data->pos,GL_FLOAT,0,2);
-        plot_data->frame_pos_buffer.release();
-
-        plot_data->frame_index_buffer.bind();
-    }
-    vao_binder.release();
-
     plot_data->title_rect.setHeight(title_h-2*h_margin);
     plot_data->title_rect.setWidth(title_w);
     plot_data->title_rect.setX(w_margin);
@@ -440,6 +791,40 @@ void SetFrameSize(PlotDataStruct *plot_data,
     plot_data->tick_labels_rect[TOP].setHeight(h_label);
 }
 
+void SetFrameSize(PlotDataStruct *plot_data,
+                  const QRect &viewport)
+{
+    SetFrameLayout(plot_data,viewport);
+
+    QRect pane = plot_data->plot_pane;
+    GLfloat pos[8];
+
+    pos[TOP_LEFT_X]     = pane.left();
+    pos[TOP_LEFT_Y]     = pane.top();
+
+    pos[BOTTOM_LEFT_X]  = pane.left();
+    pos[BOTTOM_LEFT_Y]  = pane.bottom();
+
+    pos[BOTTOM_RIGHT_X] = pane.right();
+    pos[BOTTOM_RIGHT_Y] = pane.bottom();
+
+    pos[TOP_RIGHT_X]    = pane.right();
+    pos[TOP_RIGHT_Y]    = pane.top();
+
+    QOpenGLVertexArrayObject::Binder vao_binder(&(plot_data->frame_vao));
+    {
+        plot_data->m_program.enableAttributeArray(plot_data->pos);
+
+        plot_data->frame_pos_buffer.bind();
+        plot_data->frame_pos_buffer.allocate(pos,8*sizeof(GLfloat));
+        plot_data->m_program.setAttributeBuffer(plot_data->pos,GL_FLOAT,0,2);
+        plot_data->frame_pos_buffer.release();
+
+        plot_data->frame_index_buffer.bind();
+    }
+    vao_binder.release();
+}
+
 double LinReg(const QPointF &p1, const QPointF &p2, double eval)
 {
     double m = (p2.y()-p1.y())/(p2.x()-p1.x());
@@ -448,1251 +833,3828 @@ double LinReg(const QPointF &p1, const QPointF &p2, double eval)
     return (eval*m+b);
 }
 
-void TruncLogScale(PlotDataStruct *plot_data, GLfloat *pos,
-                   int plot_index, int index)
+bool IsRingPlot(PlotDataStruct *plot_data, int plot_index)
 {
-    double x_bot = log10(plot_data->log_bottom_range[BOTTOM])-1.0;
-    double y_bot = log10(plot_data->log_bottom_range[LEFT])-1.0;
+    return plot_data->ring_capacity[plot_index] > 0;
+}
 
-    QPointF *data = plot_data->data[plot_index].data();
-    bool *logplot = plot_data->logplot;
+bool IsColumnPlot(PlotDataStruct *plot_data, int plot_index)
+{
+    return plot_data->data_column[plot_index] != nullptr;
+}
 
-    int count = plot_data->data[plot_index].count();
+int SampleSize(QOpenGL2DPlot::SampleType type)
+{
+    switch (type)
+    {
+    case QOpenGL2DPlot::Int16:
+        return sizeof(qint16);
+    case QOpenGL2DPlot::Int32:
+        return sizeof(qint32);
+    case QOpenGL2DPlot::Float:
+        return sizeof(float);
+    default:
+        return sizeof(double);
+    }
+}
 
-    if (index < count-1)
+// Doubles are narrowed to floats on upload, the other types are
+// uploaded as they are stored.
+int GpuSampleSize(QOpenGL2DPlot::SampleType type)
+{
+    if (type == QOpenGL2DPlot::Double)
     {
-        if (data[index+1].x() < plot_data->log_bottom_range[BOTTOM] &&
-                data[index+1].y() < plot_data->log_bottom_range[LEFT])
-        {
-            if (logplot[HORIZONTAL])
-            {
-                //TODO
-            }
-            else
-            {
+        return sizeof(GLfloat);
+    }
 
-            }
+    return SampleSize(type);
+}
 
-            pos[index*2]   = x_bot;
-            pos[index*2+1] = y_bot;
-        }
-        else if (data[index+1].x() < plot_data->log_bottom_range[BOTTOM])
-        {
-            pos[index*2]   = x_bot;
-            pos[index*2+1] = data[index].y();
-        }
-        else
-        {
-            pos[index*2]   = data[index].x();
-            pos[index*2+1] = y_bot;
-        }
+GLenum SampleGLType(QOpenGL2DPlot::SampleType type)
+{
+    switch (type)
+    {
+    case QOpenGL2DPlot::Int16:
+        return GL_SHORT;
+    case QOpenGL2DPlot::Int32:
+        return GL_INT;
+    default:
+        return GL_FLOAT;
     }
-    else
+}
+
+double LoadSample(const char *src, QOpenGL2DPlot::SampleType type)
+{
+    switch (type)
     {
-        if (data[index-1].x() < plot_data->log_bottom_range[BOTTOM] &&
-                data[index-1].y() < plot_data->log_bottom_range[LEFT])
-        {
-            pos[index*2]   = x_bot;
-            pos[index*2+1] = y_bot;
-        }
-        else if (data[index-1].x() < plot_data->log_bottom_range[BOTTOM])
-        {
-            pos[index*2]   = x_bot;
-            pos[index*2+1] = data[index].y();
-        }
-        else
-        {
-            pos[index*2]   = data[index].x();
-            pos[index*2+1] = y_bot;
-        }
+    case QOpenGL2DPlot::Int16:
+        return *reinterpret_cast<const qint16*>(src);
+    case QOpenGL2DPlot::Int32:
+        return *reinterpret_cast<const qint32*>(src);
+    case QOpenGL2DPlot::Float:
+        return *reinterpret_cast<const float*>(src);
+    default:
+        return *reinterpret_cast<const double*>(src);
     }
 }
 
-void SetDataPointsPosition(PlotDataStruct *plot_data, int plot_index)
+void StoreSample(char *dst, QOpenGL2DPlot::SampleType type, double value)
 {
-    QPointF *data = plot_data->data[plot_index].data();
-    bool *logplot = plot_data->logplot;
+    switch (type)
+    {
+    case QOpenGL2DPlot::Int16:
+        *reinterpret_cast<qint16*>(dst) = qint16(qBound<double>(
+                    -32768,qRound(value),32767));
+        break;
+    case QOpenGL2DPlot::Int32:
+        *reinterpret_cast<qint32*>(dst) = qRound(value);
+        break;
+    case QOpenGL2DPlot::Float:
+        *reinterpret_cast<float*>(dst) = value;
+        break;
+    default:
+        *reinterpret_cast<double*>(dst) = value;
+        break;
+    }
+}
 
-    int count = plot_data->data[plot_index].count();
-    GLfloat *pos = new GLfloat[count*2];
+const char *ColumnYData(const PlotColumnStruct *column)
+{
+    return column->external ? column->y_data : column->y.constData();
+}
 
-    for (int i = 0; i < count; i++)
-    {
-        if (logplot[HORIZONTAL])
-        {
-            if (data[i].x() > 0)
-            {
-                pos[i*2] = log10(data[i].x());
-            }
-            else
-            {
-                TruncLogScale(plot_data,pos,
-                              plot_index,i);
-                continue;
-            }
-        }
-        else
-        {
-            pos[i*2] = data[i].x();
-        }
+const char *ColumnXData(const PlotColumnStruct *column)
+{
+    return column->external ? column->x_data : column->x.constData();
+}
 
-        if (logplot[VERTICAL])
-        {
-            if (data[i].y() > 0)
-            {
-                pos[i*2+1] = log10(data[i].y());
-            }
-            else
-            {
-                TruncLogScale(plot_data,pos,
-                              plot_index,i);
-            }
-        }
-        else
-        {
-            pos[i*2+1] = data[i].y();
-        }
+double ColumnX(const PlotColumnStruct *column, int index)
+{
+    if (column->implicit_x)
+    {
+        return column->x0+index*column->dt;
     }
 
-    GLuint *index;
-    int index_count;
+    return LoadSample(ColumnXData(column)+index*column->x_stride,
+                      column->x_type);
+}
+
+double ColumnY(const PlotColumnStruct *column, int index)
+{
+    return LoadSample(ColumnYData(column)+index*column->y_stride,
+                      column->y_type);
+}
 
-    QOpenGLBuffer *pos_buffer = plot_data->data_pos_buffer.data();
-    QOpenGLBuffer *index_buffer = plot_data->data_index_buffer.data();
+QByteArray PackColumn(const char *data, int stride, int size, int count)
+{
+    QByteArray packed(count*size,Qt::Uninitialized);
 
-    if (!count)
+    for (int i = 0; i < count; i++)
     {
-        index = nullptr;
-        index_count = 0;
+        memcpy(packed.data()+i*size,data+i*stride,size);
     }
-    else if (count < 2)
+
+    return packed;
+}
+
+// A view is copied into the plot's own storage before it is modified
+// through the point or append API, the caller's buffer is never written.
+void DetachColumn(PlotColumnStruct *column)
+{
+    if (!column->external)
     {
-        index = new GLuint[1];
-        index[1] = 0;
-        index_count = 1*sizeof(GLuint);
+        return;
     }
-    else
-    {
-        index = new GLuint[(count-1)*2];
 
-        for (int i = 1; i < count-1; i++)
-        {
-            index[i*2-1] = i;
-            index[i*2]   = i;
-        }
+    column->y = PackColumn(column->y_data,column->y_stride,
+                           SampleSize(column->y_type),column->count);
 
-        index[0] = 0;
-        index[(count-1)*2-1] = count-1;
-        index_count = (count-1)*2*sizeof(GLuint);
+    if (!column->implicit_x)
+    {
+        column->x = PackColumn(column->x_data,column->x_stride,
+                               SampleSize(column->x_type),column->count);
     }
 
-    QOpenGLVertexArrayObject::Binder vao_binder(
-                plot_data->data_vao[plot_index]);
-    {
-        plot_data->m_program.enableAttributeArray(plot_data->pos);
+    column->external = false;
+    column->y_data   = nullptr;
+    column->x_data   = nullptr;
+    column->y_stride = SampleSize(column->y_type);
+    column->x_stride = SampleSize(column->x_type);
+}
 
-        pos_buffer[plot_index].bind();
-        pos_buffer[plot_index].allocate(pos,2*count*sizeof(GLfloat));
-        plot_data->m_program.setAttributeBuffer(plot_data->pos,
-                                                GL_FLOAT,0,2);
-        pos_buffer[plot_index].release();
+// The window of a capture is kept as it is once the plot is modified
+void DetachPlot(PlotDataStruct *plot_data, int plot_index)
+{
+    delete plot_data->data_capture[plot_index];
+    plot_data->data_capture[plot_index] = nullptr;
 
+    DetachColumn(plot_data->data_column[plot_index]);
+}
 
-        index_buffer[plot_index].bind();
-        index_buffer[plot_index].allocate(index,index_count);
+int PointCount(PlotDataStruct *plot_data, int plot_index)
+{
+    if (IsColumnPlot(plot_data,plot_index))
+    {
+        return plot_data->data_column[plot_index]->count;
     }
-    vao_binder.release();
 
-    delete[] pos;
-    delete[] index;
+    if (IsRingPlot(plot_data,plot_index))
+    {
+        return plot_data->ring_count[plot_index];
+    }
+
+    return plot_data->data[plot_index].count();
 }
 
-void SetLinGridPosition(PlotDataStruct *plot_data, int side)
+int PointSlot(PlotDataStruct *plot_data, int plot_index, int index)
 {
-    double bot = plot_data->bottom_range[side];
-    double top = plot_data->top_range[side];
+    if (IsRingPlot(plot_data,plot_index))
+    {
+        return (plot_data->ring_start[plot_index]+index)%
+                plot_data->ring_capacity[plot_index];
+    }
 
-    double step = plot_data->tick_step[side];
-    double rem = fabs(remainder(bot,step));
+    return index;
+}
 
-    double unit_step = step/(top-bot);
-    double unit_rem = rem/(top-bot);
+QPointF PointAt(PlotDataStruct *plot_data, int plot_index, int index)
+{
+    if (IsColumnPlot(plot_data,plot_index))
+    {
+        PlotColumnStruct *column = plot_data->data_column[plot_index];
 
-    int count = ceil((top-bot)/step);
-    plot_data->ticks_count[side] = count;
+        return QPointF(ColumnX(column,index),ColumnY(column,index));
+    }
 
-    GLfloat *pos = new GLfloat[count*4];
+    return plot_data->data[plot_index].at(
+                PointSlot(plot_data,plot_index,index));
+}
 
-    if (side == LEFT || side == RIGHT)
+void MarkDataDirty(PlotDataStruct *plot_data, int plot_index,
+                   int from, int to)
+{
+    int &begin = plot_data->data_dirty_begin[plot_index];
+    int &end   = plot_data->data_dirty_end[plot_index];
+
+    if (begin >= end)
     {
-        for (int i = 0; i < count; i++)
-        {
-            pos[i*4]   = 0;
-            pos[i*4+1] = i*unit_step+unit_rem;
-            pos[i*4+2] = 1;
-            pos[i*4+3] = pos[i*4+1];
-        }
+        begin = from;
+        end   = to;
     }
     else
     {
-        for (int i = 0; i < count; i++)
-        {
-            pos[i*4]   = i*unit_step+unit_rem;
-            pos[i*4+1] = 0;
-            pos[i*4+2] = pos[i*4];
-            pos[i*4+3] = 1;
-        }
-    }
-
-    QOpenGLShaderProgram *m_program = &(plot_data->m_program);
-    QOpenGLBuffer *grid_buffer      = &(plot_data->grid_buffer[side]);
-    QOpenGLBuffer *sec_grid_buffer  = &(plot_data->sec_grid_buffer[side]);
-
-    QOpenGLVertexArrayObject::Binder vao_binder(
-                &(plot_data->grid_vao[side]));
-    {
-        m_program->enableAttributeArray(plot_data->pos);
-        grid_buffer->bind();
-        grid_buffer->allocate(pos,4*count*sizeof(GLfloat));
-        m_program->setAttributeBuffer(plot_data->pos,GL_FLOAT,0,2);
-        plot_data->grid_buffer[side].release();
+        begin = std::min<int>(begin,from);
+        end   = std::max<int>(end,to);
     }
-    vao_binder.release();
-
-    int sec_count = plot_data->sec_ticks_count[side];
-    double unit_sec_step = unit_step/(sec_count+1.0);
+}
 
-    uint total_sec_count = (count+2)*sec_count*4;
-    plot_data->total_sec_ticks_count[side] = total_sec_count/2.0;
-    GLfloat *sec_pos = new GLfloat[total_sec_count];
+void PushRingPoint(PlotDataStruct *plot_data, int plot_index,
+                   const QPointF &point)
+{
+    int capacity = plot_data->ring_capacity[plot_index];
+    int &start   = plot_data->ring_start[plot_index];
+    int &count   = plot_data->ring_count[plot_index];
+    int &pending = plot_data->ring_pending[plot_index];
 
-    double sec_step_val;
+    plot_data->data[plot_index][(start+count)%capacity] = point;
 
-    if (side == LEFT || side == RIGHT)
+    if (count < capacity)
     {
-        for (int i = 0; i < count+2; i++)
-        {
-            for (int j = 0; j < sec_count; j++)
-            {
-                sec_step_val = unit_step*(i-1)+
-                        (j+1)*unit_sec_step+unit_rem;
-
-                sec_pos[(i*sec_count+j)*4]   = 0;
-                sec_pos[(i*sec_count+j)*4+1] = sec_step_val;
-                sec_pos[(i*sec_count+j)*4+2] = 1;
-                sec_pos[(i*sec_count+j)*4+3] = sec_step_val;
-            }
-        }
+        count++;
     }
     else
     {
-        for (int i = 0; i < count+2; i++)
-        {
-            for (int j = 0; j < sec_count; j++)
-            {
-                sec_step_val = unit_step*(i-1)+
-                        (j+1)*unit_sec_step+unit_rem;
+        start = (start+1)%capacity;
 
-                sec_pos[(i*sec_count+j)*4]   = sec_step_val;
-                sec_pos[(i*sec_count+j)*4+1] = 0;
-                sec_pos[(i*sec_count+j)*4+2] = sec_step_val;
-                sec_pos[(i*sec_count+j)*4+3] = 1;
-            }
+        // Once per turn every slot is rewritten, which moves the origin
+        // to the oldest point, see PrepareDataPoints()
+        if (start == 0)
+        {
+            MarkDataDirty(plot_data,plot_index,0,capacity);
         }
     }
 
-    QOpenGLVertexArrayObject::Binder sec_vao_binder(
-                &(plot_data->sec_grid_vao[side]));
+    if (pending < capacity)
     {
-        m_program->enableAttributeArray(plot_data->pos);
-        sec_grid_buffer->bind();
-        sec_grid_buffer->allocate(sec_pos,
-                                  total_sec_count*sizeof(GLfloat));
-        m_program->setAttributeBuffer(plot_data->pos,
-                                                GL_FLOAT,0,2);
-        sec_grid_buffer->release();
+        pending++;
     }
-    sec_vao_binder.release();
-
-    delete[] pos;
-    delete[] sec_pos;
 }
 
-void SetLogGridPosition(PlotDataStruct *plot_data, int side)
+// Only the last capacity points of a block survive, older ones would be
+// overwritten before the next upload anyway.
+void PushRingPoints(PlotDataStruct *plot_data, int plot_index,
+                    const QPointF *points, int count)
 {
-    double bot = log10(plot_data->log_bottom_range[side]);
-    double top = log10(plot_data->log_top_range[side]);
+    int capacity = plot_data->ring_capacity[plot_index];
 
-    double rem = fabs(remainder(bot,1));
+    CountPoints(plot_data,count);
 
-    double unit_step = 1.0/(top-bot);
-    double unit_rem = rem/(top-bot);
+    if (count > capacity)
+    {
+        points += count-capacity;
+        count = capacity;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        PushRingPoint(plot_data,plot_index,points[i]);
+    }
+}
 
-    int count = ceil(top-bot);
-    plot_data->ticks_count[side] = count;
+// Points written to a column plot are converted to its sample types,
+// X is dropped when it is implicit.
+void SetColumnPoints(PlotDataStruct *plot_data, int plot_index,
+                     const QPointF *points, int count, int index)
+{
+    PlotColumnStruct *column = plot_data->data_column[plot_index];
+    int y_size = SampleSize(column->y_type);
+    int x_size = SampleSize(column->x_type);
 
-    GLfloat *pos = new GLfloat[4*count];
-    double step_val;
+    DetachPlot(plot_data,plot_index);
 
-    if (side == LEFT || side == RIGHT)
+    if (column->count < index+count)
     {
-        for (int i = 0; i < count; i++)
-        {
-            step_val = i*unit_step+unit_rem;
+        column->count = index+count;
+        column->y.resize(column->count*y_size);
 
-            pos[i*4]   = 0;
-            pos[i*4+1] = step_val;
-            pos[i*4+2] = 1;
-            pos[i*4+3] = step_val;
+        if (!column->implicit_x)
+        {
+            column->x.resize(column->count*x_size);
         }
     }
-    else
+
+    char *y = column->y.data()+index*y_size;
+    char *x = column->implicit_x ? nullptr :
+                                   column->x.data()+index*x_size;
+
+    for (int i = 0; i < count; i++)
     {
-        for (int i = 0; i < count; i++)
-        {
-            step_val = i*unit_step+unit_rem;
+        StoreSample(y+i*y_size,column->y_type,points[i].y());
 
-            pos[i*4]   = step_val;
-            pos[i*4+1] = 0;
-            pos[i*4+2] = step_val;
-            pos[i*4+3] = 1;
+        if (x)
+        {
+            StoreSample(x+i*x_size,column->x_type,points[i].x());
         }
     }
 
-    QOpenGLShaderProgram *m_program = &(plot_data->m_program);
-    QOpenGLBuffer *grid_buffer      = &(plot_data->grid_buffer[side]);
-    QOpenGLBuffer *sec_grid_buffer  = &(plot_data->sec_grid_buffer[side]);
+    MarkDataDirty(plot_data,plot_index,index,index+count);
+}
 
-    QOpenGLVertexArrayObject::Binder vao_binder(
-                &(plot_data->grid_vao[side]));
-    {
-        m_program->enableAttributeArray(plot_data->pos);
-        grid_buffer->bind();
-        grid_buffer->allocate(pos,4*count*sizeof(GLfloat));
-        m_program->setAttributeBuffer(plot_data->pos,
-                                      GL_FLOAT,0,2);
-        grid_buffer->release();
-    }
-    vao_binder.release();
+void InsertColumnPoints(PlotDataStruct *plot_data, int plot_index,
+                        const QPointF *points, int count, int pos)
+{
+    PlotColumnStruct *column = plot_data->data_column[plot_index];
+    int size = column->count;
 
-    double log_sec_step[8];
+    DetachPlot(plot_data,plot_index);
+    pos = qBound(0,pos,size);
 
-    for (int i = 0; i < 8; i++)
+    QByteArray y(count*SampleSize(column->y_type),Qt::Uninitialized);
+    column->y.insert(pos*SampleSize(column->y_type),y);
+
+    if (!column->implicit_x)
     {
-        log_sec_step[i] = unit_step*log10(i+2.0);
+        QByteArray x(count*SampleSize(column->x_type),Qt::Uninitialized);
+        column->x.insert(pos*SampleSize(column->x_type),x);
     }
 
-    plot_data->total_sec_ticks_count[side] = 2*8*(count+2);
+    column->count += count;
 
-    GLfloat *sec_pos = new GLfloat[4*8*(count+2)];
-    double sec_step_val;
+    SetColumnPoints(plot_data,plot_index,points,count,pos);
+    MarkDataDirty(plot_data,plot_index,pos,size+count);
+}
 
-    if (side == LEFT || side == RIGHT)
-    {
-        for (int i = 0; i < count+2; i++)
-        {
-            for (int j = 0; j < 8; j++)
-            {
-                sec_step_val = (i-1)*unit_step+unit_rem+
-                        log_sec_step[j];
+// Opens a gap of count points at pos with a single move of the tail and
+// copies the block into it, appends never move existing points.
+void InsertPoints(PlotDataStruct *plot_data, int plot_index,
+                  const QPointF *points, int count, int pos)
+{
+    QVector<QPointF> &data = plot_data->data[plot_index];
+    int size = data.count();
 
-                sec_pos[(i*8+j)*4]   = 0;
-                sec_pos[(i*8+j)*4+1] = sec_step_val;
-                sec_pos[(i*8+j)*4+2] = 1;
-                sec_pos[(i*8+j)*4+3] = sec_step_val;
-            }
-        }
-    }
-    else
+    if (count <= 0)
     {
-        for (int i = 0; i < count+2; i++)
-        {
-            for (int j = 0; j < 8; j++)
-            {
-                sec_step_val = (i-1)*unit_step+unit_rem+
-                        log_sec_step[j];
+        return;
+    }
 
-                sec_pos[(i*8+j)*4]   = sec_step_val;
-                sec_pos[(i*8+j)*4+1] = 0;
-                sec_pos[(i*8+j)*4+2] = sec_step_val;
-                sec_pos[(i*8+j)*4+3] = 1;
-            }
-        }
+    CountPoints(plot_data,count);
+
+    if (IsColumnPlot(plot_data,plot_index))
+    {
+        InsertColumnPoints(plot_data,plot_index,points,count,pos);
+        return;
     }
 
-    QOpenGLVertexArrayObject::Binder sec_vao_binder(
-                &(plot_data->sec_grid_vao[side]));
+    pos = qBound(0,pos,size);
+    data.resize(size+count);
+
+    QPointF *ptr = data.data();
+
+    if (pos < size)
     {
-        m_program->enableAttributeArray(plot_data->pos);
-        sec_grid_buffer->bind();
-        sec_grid_buffer->allocate(sec_pos,4*8*(count+2)*
-                                  sizeof(GLfloat));
-        m_program->setAttributeBuffer(plot_data->pos,
-                                      GL_FLOAT,0,2);
-        sec_grid_buffer->release();
+        std::copy_backward(ptr+pos,ptr+size,ptr+size+count);
     }
-    sec_vao_binder.release();
 
-    delete[] pos;
-    delete[] sec_pos;
+    std::copy(points,points+count,ptr+pos);
+
+    MarkDataDirty(plot_data,plot_index,pos,size+count);
 }
 
-void SetGridPosition(PlotDataStruct *plot_data, int side)
+// Data is uploaded in linear units, relative to the plot origin so that
+// large coordinates keep their resolution once narrowed to floats. The
+// vertex shader applies the logarithmic scales.
+void TransformPoints(const QPointF *points, int count, GLfloat *pos,
+                     const QPointF &origin)
 {
-    bool logplot;
-
-    if (side == LEFT || side == RIGHT)
+    for (int i = 0; i < count; i++)
     {
-        logplot = plot_data->logplot[VERTICAL];
+        pos[i*2]   = points[i].x()-origin.x();
+        pos[i*2+1] = points[i].y()-origin.y();
     }
-    else
+}
+
+// Grows the GPU buffer of a plot geometrically so that appends only
+// have to write the new tail. Plots are drawn as line strips, so there
+// is no index buffer to maintain.
+void ReserveDataPoints(PlotDataStruct *plot_data, int plot_index,
+                       int count)
+{
+    int capacity = plot_data->data_capacity[plot_index];
+    int vertices;
+
+    if (count <= capacity)
     {
-        logplot = plot_data->logplot[HORIZONTAL];
+        return;
     }
 
-    if (logplot)
+    if (IsRingPlot(plot_data,plot_index))
     {
-        SetLogGridPosition(plot_data,side);
+        // The extra vertex mirrors the first slot and closes the ring
+        capacity = plot_data->ring_capacity[plot_index];
+        vertices = capacity+1;
+        plot_data->ring_pending[plot_index] = 0;
     }
     else
     {
-        SetLinGridPosition(plot_data,side);
+        capacity = std::max<int>(capacity*BUFFER_GROWTH_FACTOR,
+                                 MIN_BUFFER_CAPACITY);
+
+        while (capacity < count)
+        {
+            capacity *= BUFFER_GROWTH_FACTOR;
+        }
+
+        vertices = capacity;
+    }
+
+    QOpenGLBuffer *pos_buffer = &(plot_data->data_pos_buffer[plot_index]);
+
+    QOpenGLVertexArrayObject::Binder vao_binder(
+                plot_data->data_vao[plot_index]);
+    {
+        plot_data->m_program.enableAttributeArray(plot_data->pos);
+
+        pos_buffer->bind();
+        pos_buffer->allocate(2*vertices*sizeof(GLfloat));
+        plot_data->m_program.setAttributeBuffer(plot_data->pos,
+                                                GL_FLOAT,0,2);
+        pos_buffer->release();
     }
+    vao_binder.release();
+
+    plot_data->data_capacity[plot_index] = capacity;
+
+    // allocate() discards the previous contents
+    MarkDataDirty(plot_data,plot_index,0,count);
 }
 
-void SetGridPosition(PlotDataStruct *plot_data)
+// Writes the transformed points [from, to) of a plot from pos
+void WriteStagedPoints(PlotDataStruct *plot_data, int plot_index,
+                       int from, int to, const GLfloat *pos)
 {
-    for (int i = 0; i < 4; i++)
+    QOpenGLBuffer *pos_buffer = &(plot_data->data_pos_buffer[plot_index]);
+
+    pos_buffer->bind();
+    WriteBuffer(plot_data,pos_buffer,from*2*sizeof(GLfloat),pos,
+                (to-from)*2*sizeof(GLfloat));
+
+    if (from == 0 && IsRingPlot(plot_data,plot_index))
     {
-        SetGridPosition(plot_data,i);
+        WriteBuffer(plot_data,pos_buffer,
+                    2*plot_data->ring_capacity[plot_index]*sizeof(GLfloat),
+                    pos,2*sizeof(GLfloat));
     }
+
+    pos_buffer->release();
 }
 
-void SetTickLabelsPositions(PlotDataStruct *plot_data, int side)
+void WriteDataPoints(PlotDataStruct *plot_data, int plot_index,
+                     int from, int to)
 {
-    int count;
-    bool logplot;
-    float delta;
-    float rem, rel_rem;
-    float screen_rem;
+    GLfloat *pos = new GLfloat[(to-from)*2];
+    TransformPoints(plot_data->data[plot_index].constData()+from,
+                    to-from,pos,plot_data->data_origin[plot_index]);
 
-    float rel_step;
-    float tick_h,tick_w,tick_step;
+    WriteStagedPoints(plot_data,plot_index,from,to,pos);
 
-    float base_x = plot_data->tick_labels_rect[side].x();
-    float base_y = plot_data->tick_labels_rect[side].y();
-    float base_h = plot_data->tick_labels_rect[side].height();
-    float base_w = plot_data->tick_labels_rect[side].width();
+    delete[] pos;
+}
 
-    if (side == LEFT || side == RIGHT)
+void ReserveColumnSamples(PlotDataStruct *plot_data, int plot_index,
+                          int count)
+{
+    PlotColumnStruct *column = plot_data->data_column[plot_index];
+    QOpenGLShaderProgram *program = &(plot_data->column_program);
+    int capacity = plot_data->data_capacity[plot_index];
+
+    if (count <= capacity)
     {
-        logplot = plot_data->logplot[VERTICAL];
+        return;
     }
-    else
+
+    capacity = std::max<int>(capacity*BUFFER_GROWTH_FACTOR,
+                             MIN_BUFFER_CAPACITY);
+
+    while (capacity < count)
     {
-        logplot = plot_data->logplot[HORIZONTAL];
+        capacity *= BUFFER_GROWTH_FACTOR;
     }
 
-    if (logplot)
+    QOpenGLVertexArrayObject::Binder vao_binder(
+                plot_data->data_vao[plot_index]);
     {
-        delta = log10((plot_data->log_top_range[side])/(
-                                 plot_data->log_bottom_range[side]));
-        count = floor(delta)+1;
+        program->enableAttributeArray(plot_data->column_x);
+        program->enableAttributeArray(plot_data->column_y);
 
-        rem = remainder(log10(plot_data->log_bottom_range[side]),1.0);
-        rel_rem = rem/delta;
+        column->y_buffer.bind();
+        column->y_buffer.allocate(capacity*GpuSampleSize(column->y_type));
+        program->setAttributeBuffer(plot_data->column_y,
+                                    SampleGLType(column->y_type),0,1);
+        column->y_buffer.release();
 
-        rel_step = 1.0/delta;
+        if (column->implicit_x)
+        {
+            plot_data->column_index_buffer.bind();
+            program->setAttributeBuffer(plot_data->column_x,
+                                        GL_UNSIGNED_SHORT,0,1);
+            plot_data->column_index_buffer.release();
+        }
+        else
+        {
+            column->x_buffer.bind();
+            column->x_buffer.allocate(
+                        capacity*GpuSampleSize(column->x_type));
+            program->setAttributeBuffer(plot_data->column_x,
+                                        SampleGLType(column->x_type),0,1);
+            column->x_buffer.release();
+        }
     }
-    else
-    {
-        delta = plot_data->top_range[side]-plot_data->bottom_range[side];
+    vao_binder.release();
 
-        count = floor(delta/plot_data->tick_step[side])+1;
+    plot_data->data_capacity[plot_index] = capacity;
 
-        rem = remainder(plot_data->bottom_range[side],
-                        plot_data->tick_step[side]);
-        rel_rem = rem/(plot_data->top_range[side]-
-                                  plot_data->bottom_range[side]);
+    MarkDataDirty(plot_data,plot_index,0,count);
+}
 
-        rel_step = plot_data->tick_step[side]/delta;
-    }
+// Packed samples go to the GPU straight from the column or view, only
+// doubles and strided views need a staging copy.
+void WriteColumn(PlotDataStruct *plot_data, QOpenGLBuffer *buffer,
+                 const char *column, int stride,
+                 QOpenGL2DPlot::SampleType type, int from, int to,
+                 double origin)
+{
+    const char *src = column+from*stride;
+    int size = SampleSize(type);
+    int gpu_size = GpuSampleSize(type);
 
-    if (side == LEFT || side == RIGHT)
+    buffer->bind();
+
+    if (type != QOpenGL2DPlot::Double && stride == size)
     {
-        plot_data->tick_labels_rects[side].resize(count);
-        screen_rem = rel_rem*base_h;
-        tick_step = rel_step*base_h;
-        tick_h = rel_step*base_h;
+        WriteBuffer(plot_data,buffer,from*size,src,(to-from)*size);
+    }
+    else
+    {
+        char *samples = new char[(to-from)*gpu_size];
 
-        if (plot_data->tick_labels_visible[TOP] ||
-                plot_data->tick_labels_visible[BOTTOM])
+        for (int i = 0; i < to-from; i++)
         {
-            int top_h = plot_data->tick_labels_rect[TOP].height();
-            int bot_h = plot_data->tick_labels_rect[BOTTOM].height();
-
-            int max_h = std::max<int>(top_h,bot_h);
-
-            if (tick_h > max_h)
+            if (type == QOpenGL2DPlot::Double)
             {
-                tick_h = plot_data->tick_labels_rect[TOP].height();
+                GLfloat sample = LoadSample(src+i*stride,type)-origin;
+                memcpy(samples+i*gpu_size,&sample,gpu_size);
+            }
+            else
+            {
+                memcpy(samples+i*gpu_size,src+i*stride,gpu_size);
             }
         }
 
-        QRect *rects = plot_data->tick_labels_rects[side].data();
-        float step = base_y+base_h-screen_rem-0.5*tick_h;
-
-        for (int i = 0; i < count; i++)
-        {
-            rects[i].setX(base_x);
-            rects[i].setY(round(step));
-
-            rects[i].setWidth(plot_data->tick_labels_rect[side].width());
-            rects[i].setHeight(tick_h);
+        WriteBuffer(plot_data,buffer,from*gpu_size,samples,
+                    (to-from)*gpu_size);
 
-            step -= tick_step;
-        }
+        delete[] samples;
     }
-    else
-    {
-        plot_data->tick_labels_rects[side].resize(count);
-        screen_rem = rel_rem*base_w;
-        tick_step = rel_step*base_w;
-        tick_w = rel_step*base_w;
 
-        QRect *rects = plot_data->tick_labels_rects[side].data();
+    buffer->release();
+}
 
-        float step = base_x+screen_rem-0.5*tick_w;
+void WriteColumnSamples(PlotDataStruct *plot_data, int plot_index,
+                        int from, int to)
+{
+    PlotColumnStruct *column = plot_data->data_column[plot_index];
 
-        for (int i = 0; i < count; i++)
-        {
-            rects[i].setX(round(step));
-            rects[i].setY(base_y);
+    const QPointF &origin = plot_data->data_origin[plot_index];
 
-            rects[i].setHeight(base_h);
-            rects[i].setWidth(tick_w);
+    WriteColumn(plot_data,&(column->y_buffer),ColumnYData(column),
+                column->y_stride,column->y_type,from,to,origin.y());
 
-            step += tick_step;
-        }
+    if (!column->implicit_x)
+    {
+        WriteColumn(plot_data,&(column->x_buffer),ColumnXData(column),
+                    column->x_stride,column->x_type,from,to,origin.x());
     }
 }
 
-void SetTickLabelsPositions(PlotDataStruct *plot_data)
+// Drops the GL objects of the levels from "level" onwards
+void ClearLodBuffers(PlotLodStruct *lod, int level = 0)
 {
-    for (int i = 0; i < 4; i++)
+    for (int i = lod->vaos.count()-1; i >= level; i--)
     {
-        SetTickLabelsPositions(plot_data,i);
+        lod->buffers[i].destroy();
+        delete lod->vaos[i];
+    }
+
+    if (lod->vaos.count() > level)
+    {
+        lod->buffers.resize(level);
+        lod->vaos.resize(level);
+        lod->capacity.resize(level);
     }
 }
 
-QOpenGL2DPlot::QOpenGL2DPlot(QWidget *parent):
-    QOpenGLWidget(parent)
+void ClearLodLevels(PlotLodStruct *lod)
 {
-    plot_data = new PlotDataStruct;
-
-    plot_data->title          = DEFAULT_TITLE;
-    plot_data->labels[BOTTOM] = DEFAULT_BOT_LABEL;
-    plot_data->labels[TOP]    = DEFAULT_TOP_LABEL;
-    plot_data->labels[LEFT]   = DEFAULT_LEFT_LABEL;
-    plot_data->labels[RIGHT]  = DEFAULT_RIGHT_LABEL;
+    ClearLodBuffers(lod);
 
-    plot_data->logplot[HORIZONTAL] = false;
-    plot_data->logplot[VERTICAL]   = false;
+    lod->levels.clear();
+    lod->dirty.clear();
+}
 
-    plot_data->title_visible = true;
+void UploadLodLevel(PlotDataStruct *plot_data, PlotLodStruct *lod,
+                    int level, int from, const QPointF &origin)
+{
+    int count = lod->levels[level].count();
+    int capacity = lod->capacity[level];
 
-    for (int i = 0; i < 4; i++)
+    if (count > capacity)
     {
-        bool t = (i%2 == 0);
+        capacity = std::max<int>(capacity*BUFFER_GROWTH_FACTOR,
+                                 MIN_BUFFER_CAPACITY);
 
-        plot_data->labels_visible[i]      = t;
-        plot_data->tick_labels_visible[i] = t;
-        plot_data->ticks_visible[i]       = t;
-        plot_data->sec_ticks_visible[i]   = t;
-        plot_data->grid_visible[i]        = t;
-        plot_data->sec_grid_visible[i]    = t;
-    }
+        while (capacity < count)
+        {
+            capacity *= BUFFER_GROWTH_FACTOR;
+        }
 
-    plot_data->frame_color = DEFAULT_FRAME_COLOR;
+        QOpenGLVertexArrayObject::Binder vao_binder(lod->vaos[level]);
+        {
+            plot_data->m_program.enableAttributeArray(plot_data->pos);
 
-    plot_data->frame_visible = true;
-    plot_data->frame_pos_buffer = QOpenGLBuffer(
-                QOpenGLBuffer::VertexBuffer);
-    plot_data->frame_index_buffer = QOpenGLBuffer(
-                QOpenGLBuffer::IndexBuffer);
-    plot_data->m_program.setParent(this);
+            lod->buffers[level].bind();
+            lod->buffers[level].allocate(2*capacity*sizeof(GLfloat));
+            plot_data->m_program.setAttributeBuffer(plot_data->pos,
+                                                    GL_FLOAT,0,2);
+            lod->buffers[level].release();
+        }
+        vao_binder.release();
 
-    for (int i = 0; i < 4; i++)
+        lod->capacity[level] = capacity;
+        from = 0;
+    }
+
+    if (from >= count)
     {
-        plot_data->grid_buffer[i] = QOpenGLBuffer(
-                    QOpenGLBuffer::VertexBuffer);
-        plot_data->sec_grid_buffer[i] = QOpenGLBuffer(
-                    QOpenGLBuffer::VertexBuffer);
+        return;
+    }
 
-        plot_data->top_range[i]         = DEFAULT_TOP_RANGE;
-        plot_data->bottom_range[i]      = DEFAULT_BOT_RANGE;
+    GLfloat *pos = new GLfloat[(count-from)*2];
+    TransformPoints(lod->levels[level].constData()+from,
+                    count-from,pos,origin);
 
-        plot_data->tick_step[i]         = DEFAULT_TICK_STEP;
-        plot_data->sec_ticks_count[i]   = DEFAULT_SEC_TICK_COUNT;
-        plot_data->grid_color[i]        = DEFAULT_GRID_COLOR;
-        plot_data->sec_grid_color[i]    = DEFAULT_SEC_GRID_COLOR;
+    lod->buffers[level].bind();
+    WriteBuffer(plot_data,&(lod->buffers[level]),from*2*sizeof(GLfloat),
+                pos,(count-from)*2*sizeof(GLfloat));
+    lod->buffers[level].release();
 
-        plot_data->log_top_range[i]     = DEFAULT_LOG_TOP_RANGE;
-        plot_data->log_bottom_range[i]  = DEFAULT_LOG_BOT_RANGE;
-    }
+    delete[] pos;
+}
 
-    QSurfaceFormat newFormat;
-    newFormat.setProfile(QSurfaceFormat::CoreProfile);
-    newFormat.setSamples(16);
-    newFormat.setSwapBehavior(QSurfaceFormat::TripleBuffer);
-    setFormat(newFormat);
+void AppendLodBuffer(PlotLodStruct *lod)
+{
+    QOpenGLVertexArrayObject *vao = new QOpenGLVertexArrayObject;
+    vao->create();
+
+    lod->buffers.append(QOpenGLBuffer(QOpenGLBuffer::VertexBuffer));
+    lod->buffers.last().create();
+    lod->vaos.append(vao);
+    lod->capacity.append(0);
 }
 
-QOpenGL2DPlot::~QOpenGL2DPlot()
-{   
-    makeCurrent();
+// Brings the GL objects in line with the levels built on the CPU and
+// uploads every level from its dirty mark onwards.
+void UploadLodLevels(PlotDataStruct *plot_data, PlotLodStruct *lod,
+                     const QPointF &origin)
+{
+    int levels = lod->levels.count();
 
-    plot_data->m_program.bind();
-    plot_data->frame_pos_buffer.destroy();
-    plot_data->frame_index_buffer.destroy();
+    ClearLodBuffers(lod,levels);
 
-    for (int i = 0; i < plot_data->data.count(); i++)
+    while (lod->vaos.count() < levels)
     {
-        plot_data->data_pos_buffer[i].destroy();
-        plot_data->data_index_buffer[i].destroy();
+        AppendLodBuffer(lod);
     }
 
-    for (int i = 0; i < 4; i++)
+    for (int i = 0; i < levels; i++)
     {
-        plot_data->grid_buffer[i].destroy();
-        plot_data->sec_grid_buffer[i].destroy();
+        UploadLodLevel(plot_data,lod,i,lod->dirty[i],origin);
+        lod->dirty[i] = lod->levels[i].count();
     }
+}
 
-    plot_data->m_program.removeAllShaders();
-    plot_data->m_program.release();
-
-    delete plot_data->device;
+void AppendLodLevel(PlotLodStruct *lod)
+{
+    lod->levels.append(QVector<QPointF>());
+    lod->dirty.append(0);
+}
 
-    delete plot_data;
+void TruncateLodLevels(PlotLodStruct *lod, int level)
+{
+    lod->levels.resize(level);
+    lod->dirty.resize(level);
 }
 
-void DrawArrays(QOpenGLVertexArrayObject *vao,
-                const QColor &color,
-                GLsizei len, GLenum mode,
-                PlotDataStruct *plot_data)
+// Rebuilds the buckets of the levels from "level" onwards touched by the
+// source points from index "from" onwards. On append that is the last,
+// possibly partial, bucket of every level. Only the CPU levels change,
+// UploadLodLevels() uploads them later on the GL thread.
+void UpdateLodLevels(PlotLodStruct *lod, int level, const QPointF *src,
+                     int src_count, int from, int group)
 {
-    QOpenGLVertexArrayObject::Binder vao_binder(vao);
+    while ((src_count+group-1)/group >= LOD_MIN_BUCKETS)
     {
-        plot_data->m_program.setUniformValue(plot_data->col,
-                                             color);
+        int buckets = (src_count+group-1)/group;
+        int first = std::min<int>(from/group,
+                                  lod->levels.count() > level ?
+                                      lod->levels[level].count()/2 : 0);
+
+        if (lod->levels.count() == level)
+        {
+            AppendLodLevel(lod);
+        }
+
+        QVector<QPointF> &points = lod->levels[level];
+        points.resize(buckets*2);
+
+        for (int i = first; i < buckets; i++)
+        {
+            int begin = i*group;
+            int end = std::min<int>(begin+group,src_count);
+            int min = begin;
+            int max = begin;
+
+            for (int j = begin+1; j < end; j++)
+            {
+                if (src[j].y() < src[min].y())
+                {
+                    min = j;
+                }
+                if (src[j].y() > src[max].y())
+                {
+                    max = j;
+                }
+            }
+
+            points[i*2]   = src[std::min<int>(min,max)];
+            points[i*2+1] = src[std::max<int>(min,max)];
+        }
+
+        lod->dirty[level] = std::min<int>(lod->dirty[level],first*2);
 
-        plot_data->functions->glDrawArrays(mode,0,len);
+        src = points.constData();
+        src_count = points.count();
+        from = first*2;
+        group = 2*LOD_FACTOR;
+        level++;
     }
-    vao_binder.release();
+
+    TruncateLodLevels(lod,level);
 }
 
-void DrawElements(QOpenGLVertexArrayObject *vao,
-                  const QColor &color,
-                  GLsizei len, GLenum mode,
-                  PlotDataStruct *plot_data)
+void UpdateDataLod(PlotDataStruct *plot_data, int plot_index,
+                   int from, int to, bool &sorted)
 {
-    QOpenGLVertexArrayObject::Binder vao_binder(vao);
+    PlotLodStruct *lod = plot_data->data_lod.at(plot_index);
+    const QPointF *data = plot_data->data.at(plot_index).constData();
+    int count = plot_data->data.at(plot_index).count();
+
+    if (from == 0)
     {
-        plot_data->m_program.setUniformValue(plot_data->col,
-                                             color);
+        sorted = true;
+    }
 
-        plot_data->functions->glDrawElements(
-                    mode,len,GL_UNSIGNED_INT,nullptr);
+    for (int i = std::max<int>(from,1); sorted &&
+         i < std::min<int>(to+1,count); i++)
+    {
+        if (data[i].x() < data[i-1].x())
+        {
+            sorted = false;
+        }
     }
-    vao_binder.release();
-}
 
-void BufferAllocateSize(QOpenGLBuffer *pos,
-                        QOpenGLBuffer *index,
-                        int count)
-{
-    pos->create();
-    pos->bind();
-    pos->allocate(2*count*sizeof(GLfloat));
-    pos->release();
+    if (!sorted || IsRingPlot(plot_data,plot_index))
+    {
+        TruncateLodLevels(lod,0);
+        return;
+    }
 
-    index->create();
-    index->bind();
-    index->allocate((2*count-2)*sizeof(GLuint));
-    index->release();
+    UpdateLodLevels(lod,0,data,count,from,LOD_FACTOR);
 }
 
-void SetScales(PlotDataStruct *plot_data)
+template <typename T>
+void ColumnLodBuckets(const PlotColumnStruct *column, QPointF *points,
+                      int first, int buckets, int group)
 {
-    if (plot_data->logplot[HORIZONTAL])
+    const char *data = ColumnYData(column);
+    int stride = column->y_stride;
+
+    for (int i = first; i < buckets; i++)
     {
-        plot_data->x_scale =  2.0 / log10(plot_data->log_top_range[BOTTOM] /
-                             plot_data->log_bottom_range[BOTTOM]);
+        int begin = i*group;
+        int end = std::min<int>(begin+group,column->count);
+        T min = *reinterpret_cast<const T*>(data+begin*stride);
+        T max = min;
+        int min_index = begin;
+        int max_index = begin;
+
+        for (int j = begin+1; j < end; j++)
+        {
+            T y = *reinterpret_cast<const T*>(data+j*stride);
 
-        plot_data->x_offset = -log10(plot_data->log_bottom_range[BOTTOM]) *
-                plot_data->x_scale;
+            if (y < min)
+            {
+                min = y;
+                min_index = j;
+            }
+            if (y > max)
+            {
+                max = y;
+                max_index = j;
+            }
+        }
+
+        if (min_index < max_index)
+        {
+            points[i*2]   = QPointF(ColumnX(column,min_index),min);
+            points[i*2+1] = QPointF(ColumnX(column,max_index),max);
+        }
+        else
+        {
+            points[i*2]   = QPointF(ColumnX(column,max_index),max);
+            points[i*2+1] = QPointF(ColumnX(column,min_index),min);
+        }
     }
-    else
-    {
-        plot_data->x_scale =  2.0 / (plot_data->top_range[BOTTOM] -
-                          plot_data->bottom_range[BOTTOM]);
+}
 
-        plot_data->x_offset = -plot_data->bottom_range[BOTTOM] *
-                plot_data->x_scale;
+// The first level of a column plot is much coarser than the one of a
+// point plot, so the pyramid stays small next to 2 byte samples.
+void UpdateColumnLod(PlotDataStruct *plot_data, int plot_index,
+                     int from, int to, bool &sorted)
+{
+    PlotLodStruct *lod = plot_data->data_lod.at(plot_index);
+    const PlotColumnStruct *column = plot_data->data_column.at(plot_index);
+    int count = column->count;
+
+    if (from == 0 || column->implicit_x)
+    {
+        sorted = !column->implicit_x || column->dt > 0;
     }
 
-    if (plot_data->logplot[VERTICAL])
+    for (int i = std::max<int>(from,1); sorted && !column->implicit_x &&
+         i < std::min<int>(to+1,count); i++)
     {
-        plot_data->y_scale =  -2.0 / log10(plot_data->log_top_range[LEFT]/
-                             plot_data->log_bottom_range[LEFT]);
+        if (ColumnX(column,i) < ColumnX(column,i-1))
+        {
+            sorted = false;
+        }
+    }
 
-        plot_data->y_offset = -log10(plot_data->log_bottom_range[LEFT]) *
-                plot_data->y_scale;
+    int group = COLUMN_LOD_FACTOR;
+    int buckets = (count+group-1)/group;
+
+    if (!sorted || buckets < LOD_MIN_BUCKETS)
+    {
+        TruncateLodLevels(lod,0);
+        return;
     }
-    else
+
+    if (lod->levels.isEmpty())
     {
-        plot_data->y_scale = -2.0 / (plot_data->top_range[LEFT] -
-                          plot_data->bottom_range[LEFT]);
+        AppendLodLevel(lod);
+    }
 
-        plot_data->y_offset = -plot_data->bottom_range[LEFT] *
-                plot_data->y_scale;
+    int first = std::min<int>(from/group,lod->levels[0].count()/2);
+
+    QVector<QPointF> &points = lod->levels[0];
+    points.resize(buckets*2);
+
+    switch (column->y_type)
+    {
+    case QOpenGL2DPlot::Int16:
+        ColumnLodBuckets<qint16>(column,points.data(),first,buckets,group);
+        break;
+    case QOpenGL2DPlot::Int32:
+        ColumnLodBuckets<qint32>(column,points.data(),first,buckets,group);
+        break;
+    case QOpenGL2DPlot::Float:
+        ColumnLodBuckets<float>(column,points.data(),first,buckets,group);
+        break;
+    default:
+        ColumnLodBuckets<double>(column,points.data(),first,buckets,group);
+        break;
     }
+
+    lod->dirty[0] = std::min<int>(lod->dirty[0],first*2);
+
+    UpdateLodLevels(lod,1,points.constData(),points.count(),first*2,
+                    2*LOD_FACTOR);
 }
 
-void SetLogLabel(PlotDataStruct *plot_data, int side)
+// Grows the buffers of a plot to its point count and takes its dirty
+// range. The origin only moves when every uploaded point is rewritten.
+// Only doubles are staged in columns, the other types are uploaded as
+// stored and keep a zero origin, implicit X is relative to x0.
+void PrepareDataPoints(PlotDataStruct *plot_data, int plot_index,
+                       int &from, int &to)
 {
-    int base  = ceil(log10(plot_data->log_bottom_range[side]));
-    int delta = floor(log10((plot_data->log_top_range[side])/
-                     (plot_data->log_bottom_range[side])));
-    double num;
+    int count = PointCount(plot_data,plot_index);
+    PlotColumnStruct *column = plot_data->data_column[plot_index];
 
-    for (int i = 0; i <= delta; i++)
+    if (IsColumnPlot(plot_data,plot_index))
     {
-        num = pow(10,base+i);
-
-        (plot_data->tick_labels[side]).append(QString::number(num));
+        ReserveColumnSamples(plot_data,plot_index,count);
+    }
+    else
+    {
+        ReserveDataPoints(plot_data,plot_index,count);
     }
-}
 
-void SetLinLabel(PlotDataStruct *plot_data, int side)
-{
-    int base = ceil((plot_data->bottom_range[side])/
-                    (plot_data->tick_step[side]));
-    int delta = floor((plot_data->top_range[side]-plot_data->bottom_range[side])
-                      /(plot_data->tick_step[side]));
+    from = plot_data->data_dirty_begin[plot_index];
+    to   = std::min<int>(plot_data->data_dirty_end[plot_index],count);
 
-    double num = base*(plot_data->tick_step[side]);
+    plot_data->data_dirty_begin[plot_index] = 0;
+    plot_data->data_dirty_end[plot_index]   = 0;
 
-    for (int i = 0; i <= delta; i++)
+    if (from != 0 || to < count || count == 0)
     {
-        (plot_data->tick_labels[side]).append(QString::number(num));
+        return;
+    }
 
-        num += plot_data->tick_step[side];
+    QPointF &origin = plot_data->data_origin[plot_index];
+
+    // The whole ring is written from the dirty range
+    plot_data->ring_pending[plot_index] = 0;
+
+    if (IsColumnPlot(plot_data,plot_index))
+    {
+        origin.setX(column->implicit_x ? column->x0 :
+                    column->x_type == QOpenGL2DPlot::Double ?
+                        ColumnX(column,0) : 0);
+        origin.setY(column->y_type == QOpenGL2DPlot::Double ?
+                        ColumnY(column,0) : 0);
+    }
+    else
+    {
+        origin = PointAt(plot_data,plot_index,0);
     }
 }
 
-void SetLabels(PlotDataStruct *plot_data, int side)
+// Ring plots keep their points in slots, so the ranges below are slot
+// ranges. The most recent pushes are at most two contiguous slot spans.
+void UploadDataPoints(PlotDataStruct *plot_data, int plot_index,
+                      int from, int to, const GLfloat *pos)
 {
-    plot_data->tick_labels[side].clear();
+    PlotLodStruct *lod = plot_data->data_lod[plot_index];
+    const QPointF &origin = plot_data->data_origin[plot_index];
 
-    if (side == LEFT || side == RIGHT)
+    if (IsColumnPlot(plot_data,plot_index))
     {
-        if (plot_data->logplot[VERTICAL])
-        {
-            SetLogLabel(plot_data,side);
-        }
-        else
+        if (from < to)
         {
-            SetLinLabel(plot_data,side);
+            WriteColumnSamples(plot_data,plot_index,from,to);
         }
+
+        UploadLodLevels(plot_data,lod,origin);
+        return;
     }
-    else
+
+    if (from < to)
     {
-        if (plot_data->logplot[HORIZONTAL])
+        WriteStagedPoints(plot_data,plot_index,from,to,pos);
+    }
+
+    UploadLodLevels(plot_data,lod,origin);
+
+    if (IsRingPlot(plot_data,plot_index))
+    {
+        int count    = PointCount(plot_data,plot_index);
+        int capacity = plot_data->ring_capacity[plot_index];
+        int pending  = plot_data->ring_pending[plot_index];
+
+        plot_data->ring_pending[plot_index] = 0;
+
+        from = (plot_data->ring_start[plot_index]+count-pending)%capacity;
+        to   = from+pending;
+
+        if (to > capacity)
         {
-            SetLogLabel(plot_data,side);
+            WriteDataPoints(plot_data,plot_index,from,capacity);
+            WriteDataPoints(plot_data,plot_index,0,to-capacity);
         }
-        else
+        else if (from < to)
         {
-            SetLinLabel(plot_data,side);
+            WriteDataPoints(plot_data,plot_index,from,to);
         }
     }
 }
 
-void SetLabels(PlotDataStruct *plot_data)
+// Coalesces repaint requests into one update() per frame interval,
+// counted from the start of the last frame.
+void ScheduleUpdate(PlotDataStruct *plot_data)
 {
-    for (int i = 0; i < 4; i++)
+    if (plot_data->frame_timer.isActive())
     {
-        SetLabels(plot_data,i);
+        return;
+    }
+
+    int delay = 0;
+
+    if (plot_data->max_frame_rate > 0 && plot_data->frame_clock.isValid())
+    {
+        int interval = floor(1000.0/plot_data->max_frame_rate);
+
+        delay = std::max<int>(interval-plot_data->frame_clock.elapsed(),0);
     }
+
+    plot_data->frame_timer.start(delay);
 }
 
-void InitializeFrameData(PlotDataStruct *plot_data, const QRect &rect)
+// Setters only record what they affect, the work is done once in
+// ValidateState() at the next paintGL(). Plot data carries its own
+// dirty ranges.
+void Invalidate(PlotDataStruct *plot_data, uint flags)
 {
-    plot_data->frame_vao.create();
-    plot_data->frame_vao.bind();
-    BufferAllocateSize(&(plot_data->frame_pos_buffer),
-                       &(plot_data->frame_index_buffer),4);
-    plot_data->frame_vao.release();
+    plot_data->dirty |= flags;
+    ScheduleUpdate(plot_data);
+}
 
-    GLuint frame_index[4] = {
-        0,1,2,3
-    };
+// Hands the GL objects of a plot over to be destroyed at the next frame,
+// setters may run without the owning context, or on another thread.
+void ReleasePlotObjects(PlotDataStruct *plot_data, int plot_index)
+{
+    PlotLodStruct *lod = plot_data->data_lod[plot_index];
 
-    plot_data->frame_index_buffer.bind();
-    plot_data->frame_index_buffer.write(0,frame_index,4*sizeof(GLuint));
-    plot_data->frame_index_buffer.release();
-    SetFrameSize(plot_data,rect);
+    plot_data->released_buffers += lod->buffers;
+    plot_data->released_vaos    += lod->vaos;
 
-    QOpenGLVertexArrayObject::Binder vao_binder(
-                &(plot_data->frame_vao));
+    lod->buffers.clear();
+    lod->vaos.clear();
+    lod->capacity.clear();
+    lod->levels.clear();
+    lod->dirty.clear();
+
+    if (IsColumnPlot(plot_data,plot_index))
     {
-        plot_data->m_program.enableAttributeArray(plot_data->pos);
+        plot_data->released_buffers.append(
+                    plot_data->data_column[plot_index]->y_buffer);
+        plot_data->released_buffers.append(
+                    plot_data->data_column[plot_index]->x_buffer);
+    }
 
-        plot_data->frame_pos_buffer.bind();
-        plot_data->m_program.setAttributeBuffer(plot_data->pos,GL_FLOAT,0,2);
+    plot_data->released_buffers.append(plot_data->data_pos_buffer[plot_index]);
+    plot_data->data_pos_buffer[plot_index] =
+            QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
 
-        plot_data->frame_index_buffer.bind();
+    if (plot_data->data_vao[plot_index])
+    {
+        plot_data->released_vaos.append(plot_data->data_vao[plot_index]);
+        plot_data->data_vao[plot_index] = nullptr;
     }
-    vao_binder.release();
 }
 
-void QOpenGL2DPlot::initializeGL()
+// Called with the owning context current
+void DestroyReleasedObjects(PlotDataStruct *plot_data)
 {
-    initializeOpenGLFunctions();
-
-    plot_data->context = context();
-    plot_data->functions = context()->functions();
-    this->glClearColor(1,1,1,0);
-
-    plot_data->m_program.addShaderFromSourceCode(
-                QOpenGLShader::Vertex, vertexShaderSource);
-    plot_data->m_program.addShaderFromSourceCode(
-                QOpenGLShader::Fragment, vertexFragmentSource);
-    plot_data->m_program.create();
-    plot_data->m_program.link();
-    plot_data->m_program.bindAttributeLocation("pos",0);
-    plot_data->m_program.bind();
-
-    plot_data->pos = plot_data->m_program.attributeLocation("pos");
-    plot_data->col = plot_data->m_program.uniformLocation("col");
-    plot_data->mat = plot_data->m_program.uniformLocation("matrix");
-
-    InitializeFrameData(plot_data, rect());
-
-    for (int i = 0; i < plot_data->data.count(); i++)
+    for (QOpenGLBuffer &buffer : plot_data->released_buffers)
     {
-        plot_data->data_vao[i]->create();
-
-        BufferAllocateSize(&(plot_data->data_pos_buffer[i]),
-                           &(plot_data->data_index_buffer[i]),
-                           plot_data->data[i].count());
-        SetDataPointsPosition(plot_data,i);
+        buffer.destroy();
     }
 
-    for (int i = 0; i < 4; i++)
+    foreach (QOpenGLVertexArrayObject *vao, plot_data->released_vaos)
     {
-        plot_data->grid_vao[i].create();
-        plot_data->grid_buffer[i].create();
-
-        plot_data->sec_grid_vao[i].create();
-        plot_data->sec_grid_buffer[i].create();
+        delete vao;
     }
 
-    SetGridPosition(plot_data);
-
-    plot_data->m_program.release();
-
-    SetTickLabelsPositions(plot_data);
-    SetScales(plot_data);
-    SetLabels(plot_data);
-
-    plot_data->device = new QOpenGLPaintDevice();
+    plot_data->released_buffers.clear();
+    plot_data->released_vaos.clear();
 }
 
-void SetFontRelativeSize(QPainter *painter, const QString &text,
-                         const QRect &rect, float font_factor = 1.0)
+// Drops the samples and GL objects of a plot before it changes between
+// points and columns. The VAO is replaced since both layouts enable
+// different attributes, everything is recreated on the next upload.
+void ResetPlotStorage(PlotDataStruct *plot_data, int plot_index)
 {
-    QFont font;
-    QFontMetrics metrics(font);
-
-    int size_h = rect.height();
-    int size_w = floor(rect.width()/(text.length()));
-    int size   = std::min<int>(size_h,size_w);
-
-    float font_size = font_factor*metrics.height();
+    ReleasePlotObjects(plot_data,plot_index);
 
-    if (size < font_size)
-    {
-        float rel_size = size/font_size;
-        size = round(font.pointSize()*rel_size*font_factor);
-
-        if (size <= 0)
-        {
-            size = 1;
-        }
-
-        font.setPointSize(size);
-    }
-    else
+    if (IsColumnPlot(plot_data,plot_index))
     {
-        font.setPointSize(font.pointSize()*font_factor);
+        delete plot_data->data_column[plot_index];
+        plot_data->data_column[plot_index] = nullptr;
     }
 
-    painter->setFont(font);
+    delete plot_data->data_capture[plot_index];
+    plot_data->data_capture[plot_index] = nullptr;
+
+    plot_data->data[plot_index].clear();
+    plot_data->data_capacity[plot_index]    = 0;
+    plot_data->data_dirty_begin[plot_index] = 0;
+    plot_data->data_dirty_end[plot_index]   = 0;
+    plot_data->ring_capacity[plot_index]    = 0;
+    plot_data->ring_start[plot_index]       = 0;
+    plot_data->ring_count[plot_index]       = 0;
+    plot_data->ring_pending[plot_index]     = 0;
+    plot_data->data_origin[plot_index]      = QPointF(0,0);
 }
 
-void SetFontRelativeSize(QPainter *painter, const QString &text,
-                         const QRectF &rect, float font_factor = 1.0)
+// Returns the column storage of a plot with the given layout, any other
+// storage is dropped first.
+PlotColumnStruct *ColumnStorage(PlotDataStruct *plot_data, int plot_index,
+                                QOpenGL2DPlot::SampleType y_type,
+                                QOpenGL2DPlot::SampleType x_type,
+                                bool implicit_x)
 {
-    SetFontRelativeSize(painter,text,rect.toRect(),font_factor);
-}
+    PlotColumnStruct *column = plot_data->data_column[plot_index];
 
-void DrawTitle(PlotDataStruct *plot_data)
-{
-    if (!(plot_data->title_visible))
+    delete plot_data->data_capture[plot_index];
+    plot_data->data_capture[plot_index] = nullptr;
+
+    if (column && column->y_type == y_type &&
+        column->implicit_x == implicit_x &&
+        (implicit_x || column->x_type == x_type))
     {
-        return;
+        return column;
     }
 
-    SetFontRelativeSize(&(plot_data->painter),plot_data->title,
-                        plot_data->title_rect,2.0);
+    ResetPlotStorage(plot_data,plot_index);
+
+    column = new PlotColumnStruct;
+    column->y_type     = y_type;
+    column->x_type     = x_type;
+    column->implicit_x = implicit_x;
+    column->external   = false;
+    column->y_data     = nullptr;
+    column->x_data     = nullptr;
+    column->y_stride   = SampleSize(y_type);
+    column->x_stride   = SampleSize(x_type);
+    column->count      = 0;
+    column->x0         = 0;
+    column->dt         = 1;
+    column->y_buffer   = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+    column->x_buffer   = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+
+    plot_data->data_column[plot_index] = column;
+
+    return column;
+}
 
-    plot_data->painter.drawText(plot_data->title_rect,
-                                plot_data->title,
-                                QTextOption(Qt::AlignCenter));
+bool IsVerticalSide(int side)
+{
+    return side == LEFT || side == RIGHT;
 }
 
-void DrawLabels(PlotDataStruct *plot_data)
+// Grid line positions of a side as fractions of the plot pane, counted
+// from its bottom or left edge. Major lines start at the first tick
+// step, minor ones fill one step before and after them as well.
+void GridSteps(PlotDataStruct *plot_data, int side,
+               QVector<double> &major, QVector<double> &minor)
 {
-    int x_c;
-    int y_c;
+    bool logplot = plot_data->logplot[IsVerticalSide(side) ? VERTICAL :
+                                                             HORIZONTAL];
 
-    QPainter *painter = &(plot_data->painter);
+    double bot, top, step;
 
-    if (plot_data->labels_visible[LEFT])
+    if (logplot)
     {
-        x_c = floor(plot_data->labels_rect[LEFT].topLeft().x()+
-                    plot_data->viewport.width()/2.0);
-        y_c = floor(plot_data->labels_rect[LEFT].topLeft().y()+
-                    plot_data->viewport.height()/2.0);
-
-        painter->translate(x_c,y_c);
-        painter->rotate(-90);
-        painter->translate(-plot_data->labels_rect[LEFT].topLeft().x()+
-                          floor(plot_data->viewport.height()/2.0)-
-                          plot_data->labels_rect[LEFT].width(),
-                          -plot_data->labels_rect[LEFT].topLeft().y()-
-                          floor(plot_data->viewport.width()/2.0));
-
-        SetFontRelativeSize(painter,plot_data->labels[LEFT],
-                            plot_data->labels_rect[LEFT]);
-
-        painter->drawText(plot_data->labels_rect[LEFT],
-                         plot_data->labels[LEFT],
-                         QTextOption(Qt::AlignCenter));
-
-        painter->resetTransform();
+        bot  = log10(plot_data->log_bottom_range[side]);
+        top  = log10(plot_data->log_top_range[side]);
+        step = 1;
     }
-
-    if (plot_data->labels_visible[RIGHT])
+    else
     {
-        x_c = floor(plot_data->labels_rect[RIGHT].topLeft().x()+
-                    plot_data->viewport.width()/2.0);
-        y_c = floor(plot_data->labels_rect[RIGHT].topLeft().y()+
-                    plot_data->viewport.height()/2.0);
+        bot  = plot_data->bottom_range[side];
+        top  = plot_data->top_range[side];
+        step = plot_data->tick_step[side];
+    }
 
-        painter->translate(x_c,y_c);
-        painter->rotate(-90);
-        painter->translate(-plot_data->labels_rect[RIGHT].topRight().x()+
-                          floor(plot_data->viewport.height()/2.0)-1,
-                          -plot_data->labels_rect[RIGHT].topRight().y()-
-                          floor(plot_data->viewport.width()/2.0));
+    double rem = fabs(remainder(bot,step));
 
-        SetFontRelativeSize(painter,plot_data->labels[RIGHT],
-                            plot_data->labels_rect[RIGHT]);
+    double unit_step = step/(top-bot);
+    double unit_rem = rem/(top-bot);
 
-        painter->drawText(plot_data->labels_rect[RIGHT],
-                          plot_data->labels[RIGHT],
-                         QTextOption(Qt::AlignCenter));
+    int count = ceil((top-bot)/step);
+    int sec_count = logplot ? 8 : plot_data->sec_ticks_count[side];
 
-        painter->resetTransform();
-    }
+    major.resize(count);
+    minor.resize((count+2)*sec_count);
 
-    if (plot_data->labels_visible[BOTTOM])
+    for (int i = 0; i < count; i++)
     {
-        painter->drawText(plot_data->labels_rect[BOTTOM],
-                          plot_data->labels[BOTTOM],
-                         QTextOption(Qt::AlignCenter));
+        major[i] = i*unit_step+unit_rem;
     }
 
-    if (plot_data->labels_visible[TOP])
+    for (int i = 0; i < count+2; i++)
     {
-        painter->drawText(plot_data->labels_rect[TOP],
-                          plot_data->labels[TOP],
-                         QTextOption(Qt::AlignCenter));
+        for (int j = 0; j < sec_count; j++)
+        {
+            // Logarithmic minor lines sit at 2..9 times the decade
+            double offset = logplot ? unit_step*log10(j+2.0) :
+                                      (j+1)*unit_step/(sec_count+1.0);
+
+            minor[i*sec_count+j] = unit_step*(i-1)+unit_rem+offset;
+        }
     }
+}
 
-    //TICK LABELS
+void UploadGridLines(PlotDataStruct *plot_data, int side,
+                     const QVector<double> &steps,
+                     QOpenGLVertexArrayObject *vao, QOpenGLBuffer *buffer)
+{
+    QVector<GLfloat> pos(steps.count()*4);
 
-    for (int i = 0; i < 4; i++)
+    for (int i = 0; i < steps.count(); i++)
     {
-        if (plot_data->tick_labels_visible[i])
+        if (IsVerticalSide(side))
         {
-            QRect *tick_rects = plot_data->tick_labels_rects[i].data();
-            int count = plot_data->tick_labels_rects[i].count();
-            QString *tick_labels = plot_data->tick_labels[i].data();
+            pos[i*4]   = 0;
+            pos[i*4+1] = steps[i];
+            pos[i*4+2] = 1;
+            pos[i*4+3] = steps[i];
+        }
+        else
+        {
+            pos[i*4]   = steps[i];
+            pos[i*4+1] = 0;
+            pos[i*4+2] = steps[i];
+            pos[i*4+3] = 1;
+        }
+    }
 
-            for (int j = 0; j < count; j++)
-            {
-                SetFontRelativeSize(painter,tick_labels[j],
-                                    tick_rects[i]);
+    QOpenGLShaderProgram *m_program = &(plot_data->m_program);
 
-                painter->drawText(tick_rects[j],tick_labels[j],
-                                  QTextOption(Qt::AlignCenter));
-            }
-        }
+    QOpenGLVertexArrayObject::Binder vao_binder(vao);
+    {
+        m_program->enableAttributeArray(plot_data->pos);
+        buffer->bind();
+        buffer->allocate(pos.constData(),pos.count()*sizeof(GLfloat));
+        CountUpload(plot_data,pos.count()*sizeof(GLfloat));
+        m_program->setAttributeBuffer(plot_data->pos,GL_FLOAT,0,2);
+        buffer->release();
     }
+    vao_binder.release();
 }
 
-void DrawFrame(PlotDataStruct *plot_data)
+void SetGridPosition(PlotDataStruct *plot_data, int side)
 {
-    plot_data->functions->glDisable(GL_MULTISAMPLE);
+    QVector<double> major;
+    QVector<double> minor;
 
-    if (plot_data->frame_visible)
-    {
-        plot_data->m_program.setUniformValue(plot_data->mat,
-                                             plot_data->matrix);
+    GridSteps(plot_data,side,major,minor);
 
-        if (plot_data->frame_vao.isCreated())
-        {
-            DrawElements(&plot_data->frame_vao,
-                     plot_data->frame_color,
-                     4,GL_LINE_LOOP,plot_data);
-        }
+    plot_data->ticks_count[side] = major.count();
+    plot_data->total_sec_ticks_count[side] = 2*minor.count();
+
+    UploadGridLines(plot_data,side,major,&(plot_data->grid_vao[side]),
+                    &(plot_data->grid_buffer[side]));
+    UploadGridLines(plot_data,side,minor,&(plot_data->sec_grid_vao[side]),
+                    &(plot_data->sec_grid_buffer[side]));
+}
+
+void SetGridPosition(PlotDataStruct *plot_data)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        SetGridPosition(plot_data,i);
     }
 }
 
-void DrawGrid(PlotDataStruct *plot_data)
+void SetTickLabelsPositions(PlotDataStruct *plot_data, int side)
 {
     int count;
-    plot_data->m_program.setUniformValue(plot_data->mat,
-                                         plot_data->grid_matrix);
+    bool logplot;
+    float delta;
+    float rem, rel_rem;
+    float screen_rem;
 
-    for (int i = 0; i < 4; i++)
-    {
-        if (plot_data->sec_grid_visible[i])
-        {
-            count = plot_data->total_sec_ticks_count[i];
+    float rel_step;
+    float tick_h,tick_w,tick_step;
 
-            plot_data->m_program.setUniformValue(plot_data->col,
-                                                 plot_data->sec_grid_color[i]);
+    float base_x = plot_data->tick_labels_rect[side].x();
+    float base_y = plot_data->tick_labels_rect[side].y();
+    float base_h = plot_data->tick_labels_rect[side].height();
+    float base_w = plot_data->tick_labels_rect[side].width();
 
-            DrawArrays(&(plot_data->sec_grid_vao[i]),
-                       plot_data->sec_grid_color[i],
-                       count,GL_LINES,plot_data);
-        }
+    if (side == LEFT || side == RIGHT)
+    {
+        logplot = plot_data->logplot[VERTICAL];
+    }
+    else
+    {
+        logplot = plot_data->logplot[HORIZONTAL];
     }
 
-    for (int i = 0; i < 4; i++)
+    if (logplot)
     {
-        if (plot_data->grid_visible[i])
-        {
-            count = 2*plot_data->ticks_count[i];
+        delta = log10((plot_data->log_top_range[side])/(
+                                 plot_data->log_bottom_range[side]));
+        count = floor(delta)+1;
 
-            plot_data->m_program.setUniformValue(plot_data->col,
-                                                 plot_data->grid_color[i]);
+        rem = remainder(log10(plot_data->log_bottom_range[side]),1.0);
+        rel_rem = rem/delta;
 
-            DrawArrays(&(plot_data->grid_vao[i]),
-                       plot_data->grid_color[i],
-                       count,GL_LINES,plot_data);
-        }
+        rel_step = 1.0/delta;
     }
-}
+    else
+    {
+        delta = plot_data->top_range[side]-plot_data->bottom_range[side];
 
-void DrawData(PlotDataStruct *plot_data)
-{
-    plot_data->functions->glEnable(GL_MULTISAMPLE);
-    plot_data->m_program.setUniformValue("matrix",
-                                         plot_data->data_matrix);
+        count = floor(delta/plot_data->tick_step[side])+1;
+
+        rem = remainder(plot_data->bottom_range[side],
+                        plot_data->tick_step[side]);
+        rel_rem = rem/(plot_data->top_range[side]-
+                                  plot_data->bottom_range[side]);
+
+        rel_step = plot_data->tick_step[side]/delta;
+    }
+
+    if (side == LEFT || side == RIGHT)
+    {
+        plot_data->tick_labels_rects[side].resize(count);
+        screen_rem = rel_rem*base_h;
+        tick_step = rel_step*base_h;
+        tick_h = rel_step*base_h;
+
+        if (plot_data->tick_labels_visible[TOP] ||
+                plot_data->tick_labels_visible[BOTTOM])
+        {
+            int top_h = plot_data->tick_labels_rect[TOP].height();
+            int bot_h = plot_data->tick_labels_rect[BOTTOM].height();
+
+            int max_h = std::max<int>(top_h,bot_h);
+
+            if (tick_h > max_h)
+            {
+                tick_h = plot_data->tick_labels_rect[TOP].height();
+            }
+        }
+
+        QRect *rects = plot_data->tick_labels_rects[side].data();
+        float step = base_y+base_h-screen_rem-0.5*tick_h;
+
+        for (int i = 0; i < count; i++)
+        {
+            rects[i].setX(base_x);
+            rects[i].setY(round(step));
+
+            rects[i].setWidth(plot_data->tick_labels_rect[side].width());
+            rects[i].setHeight(tick_h);
+
+            step -= tick_step;
+        }
+    }
+    else
+    {
+        plot_data->tick_labels_rects[side].resize(count);
+        screen_rem = rel_rem*base_w;
+        tick_step = rel_step*base_w;
+        tick_w = rel_step*base_w;
+
+        QRect *rects = plot_data->tick_labels_rects[side].data();
+
+        float step = base_x+screen_rem-0.5*tick_w;
+
+        for (int i = 0; i < count; i++)
+        {
+            rects[i].setX(round(step));
+            rects[i].setY(base_y);
+
+            rects[i].setHeight(base_h);
+            rects[i].setWidth(tick_w);
+
+            step += tick_step;
+        }
+    }
+}
+
+void SetTickLabelsPositions(PlotDataStruct *plot_data)
+{
+    plot_data->dirty |= DIRTY_TEXT;
+
+    for (int i = 0; i < 4; i++)
+    {
+        SetTickLabelsPositions(plot_data,i);
+    }
+}
+
+QOpenGL2DPlot::QOpenGL2DPlot(QWidget *parent):
+    QOpenGLWidget(parent)
+{
+    plot_data = new PlotDataStruct;
+
+    plot_data->title          = DEFAULT_TITLE;
+    plot_data->labels[BOTTOM] = DEFAULT_BOT_LABEL;
+    plot_data->labels[TOP]    = DEFAULT_TOP_LABEL;
+    plot_data->labels[LEFT]   = DEFAULT_LEFT_LABEL;
+    plot_data->labels[RIGHT]  = DEFAULT_RIGHT_LABEL;
+
+    plot_data->logplot[HORIZONTAL] = false;
+    plot_data->logplot[VERTICAL]   = false;
+
+    plot_data->title_visible = true;
+
+    for (int i = 0; i < 4; i++)
+    {
+        bool t = (i%2 == 0);
+
+        plot_data->labels_visible[i]      = t;
+        plot_data->tick_labels_visible[i] = t;
+        plot_data->ticks_visible[i]       = t;
+        plot_data->sec_ticks_visible[i]   = t;
+        plot_data->grid_visible[i]        = t;
+        plot_data->sec_grid_visible[i]    = t;
+    }
+
+    plot_data->frame_color = DEFAULT_FRAME_COLOR;
+
+    plot_data->frame_visible = true;
+    plot_data->frame_pos_buffer = QOpenGLBuffer(
+                QOpenGLBuffer::VertexBuffer);
+    plot_data->frame_index_buffer = QOpenGLBuffer(
+                QOpenGLBuffer::IndexBuffer);
+    plot_data->m_program.setParent(this);
+
+    plot_data->text_color = DEFAULT_TEXT_COLOR;
+    plot_data->dirty = DIRTY_ALL;
+    plot_data->text_buffer = QOpenGLBuffer(
+                QOpenGLBuffer::VertexBuffer);
+    plot_data->text_program.setParent(this);
+
+    plot_data->column_index_buffer = QOpenGLBuffer(
+                QOpenGLBuffer::VertexBuffer);
+    plot_data->column_program.setParent(this);
+
+    plot_data->layer_buffer = QOpenGLBuffer(
+                QOpenGLBuffer::VertexBuffer);
+    plot_data->layer_program.setParent(this);
+    plot_data->under_layer = nullptr;
+    plot_data->over_layer = nullptr;
+
+    plot_data->context   = nullptr;
+    plot_data->functions = nullptr;
+    plot_data->device    = nullptr;
+
+    for (int i = 0; i < 4; i++)
+    {
+        plot_data->grid_buffer[i] = QOpenGLBuffer(
+                    QOpenGLBuffer::VertexBuffer);
+        plot_data->sec_grid_buffer[i] = QOpenGLBuffer(
+                    QOpenGLBuffer::VertexBuffer);
+
+        plot_data->top_range[i]         = DEFAULT_TOP_RANGE;
+        plot_data->bottom_range[i]      = DEFAULT_BOT_RANGE;
+
+        plot_data->tick_step[i]         = DEFAULT_TICK_STEP;
+        plot_data->sec_ticks_count[i]   = DEFAULT_SEC_TICK_COUNT;
+        plot_data->grid_color[i]        = DEFAULT_GRID_COLOR;
+        plot_data->sec_grid_color[i]    = DEFAULT_SEC_GRID_COLOR;
+
+        plot_data->log_top_range[i]     = DEFAULT_LOG_TOP_RANGE;
+        plot_data->log_bottom_range[i]  = DEFAULT_LOG_BOT_RANGE;
+    }
+
+    plot_data->max_frame_rate = DEFAULT_MAX_FRAME_RATE;
+
+    if (QGuiApplication::primaryScreen())
+    {
+        plot_data->max_frame_rate =
+                QGuiApplication::primaryScreen()->refreshRate();
+    }
+
+    plot_data->stats_enabled  = false;
+    plot_data->stats_stage    = NO_STAGE;
+    plot_data->stats_mark     = 0;
+    plot_data->stats_window   = 1;
+    plot_data->stats_frames   = 0;
+    plot_data->gpu_query_next = 0;
+
+    ClearFrameStats(plot_data->stats);
+    ClearFrameStats(plot_data->last_stats);
+
+    for (int i = 0; i < GPU_QUERIES; i++)
+    {
+        plot_data->gpu_query[i] = nullptr;
+        plot_data->gpu_query_pending[i] = false;
+    }
+
+    plot_data->frame_timer.setSingleShot(true);
+    plot_data->frame_timer.setTimerType(Qt::PreciseTimer);
+    connect(&(plot_data->frame_timer),SIGNAL(timeout()),
+            this,SLOT(update()));
+
+    QSurfaceFormat newFormat;
+    newFormat.setProfile(QSurfaceFormat::CoreProfile);
+    newFormat.setSamples(16);
+    newFormat.setSwapBehavior(QSurfaceFormat::TripleBuffer);
+    setFormat(newFormat);
+}
+
+QOpenGL2DPlot::~QOpenGL2DPlot()
+{   
+    makeCurrent();
+
+    ReleaseGL();
+
+    for (int i = 0; i < plot_data->data.count(); i++)
+    {
+        delete plot_data->data_vao[i];
+        delete plot_data->data_lod[i];
+        delete plot_data->data_producer[i];
+
+        if (IsColumnPlot(plot_data,i))
+        {
+            delete plot_data->data_column[i];
+        }
+
+        delete plot_data->data_capture[i];
+    }
+
+    foreach (QOpenGLVertexArrayObject *vao, plot_data->released_vaos)
+    {
+        delete vao;
+    }
+
+    delete plot_data;
+}
+
+// Frees the GL objects of the plot while the context they were created
+// in is current. Objects of a context current elsewhere are left to be
+// reclaimed with that context.
+void QOpenGL2DPlot::ReleaseGL()
+{
+    if (!plot_data->context ||
+        plot_data->context != QOpenGLContext::currentContext())
+    {
+        return;
+    }
+
+    plot_data->m_program.bind();
+    plot_data->frame_pos_buffer.destroy();
+    plot_data->frame_index_buffer.destroy();
+    plot_data->frame_vao.destroy();
+
+    DestroyReleasedObjects(plot_data);
+
+    for (int i = 0; i < plot_data->data.count(); i++)
+    {
+        plot_data->data_pos_buffer[i].destroy();
+        delete plot_data->data_vao[i];
+        plot_data->data_vao[i] = nullptr;
+
+        ClearLodLevels(plot_data->data_lod[i]);
+
+        if (IsColumnPlot(plot_data,i))
+        {
+            plot_data->data_column[i]->y_buffer.destroy();
+            plot_data->data_column[i]->x_buffer.destroy();
+        }
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        plot_data->grid_buffer[i].destroy();
+        plot_data->grid_vao[i].destroy();
+        plot_data->sec_grid_buffer[i].destroy();
+        plot_data->sec_grid_vao[i].destroy();
+    }
+
+    plot_data->m_program.removeAllShaders();
+    plot_data->m_program.release();
+
+    plot_data->column_index_buffer.destroy();
+    plot_data->column_program.removeAllShaders();
+
+    plot_data->text_buffer.destroy();
+    plot_data->text_vao.destroy();
+    plot_data->text_program.removeAllShaders();
+
+    plot_data->layer_buffer.destroy();
+    plot_data->layer_vao.destroy();
+    plot_data->layer_program.removeAllShaders();
+    delete plot_data->under_layer;
+    delete plot_data->over_layer;
+    plot_data->under_layer = nullptr;
+    plot_data->over_layer  = nullptr;
+
+    for (int i = 0; i < GPU_QUERIES; i++)
+    {
+        delete plot_data->gpu_query[i];
+        plot_data->gpu_query[i] = nullptr;
+    }
+
+    foreach (GlyphAtlasStruct *atlas, plot_data->glyph_atlas)
+    {
+        delete atlas->texture;
+        delete atlas;
+    }
+
+    plot_data->glyph_atlas.clear();
+
+    delete plot_data->device;
+    plot_data->device = nullptr;
+
+    plot_data->context   = nullptr;
+    plot_data->functions = nullptr;
+}
+
+void DrawArrays(QOpenGLVertexArrayObject *vao,
+                const QColor &color,
+                GLsizei len, GLenum mode,
+                PlotDataStruct *plot_data,
+                GLint first = 0)
+{
+    QOpenGLVertexArrayObject::Binder vao_binder(vao);
+    {
+        plot_data->m_program.setUniformValue(plot_data->col,
+                                             color);
+
+        plot_data->functions->glDrawArrays(mode,first,len);
+        CountDraw(plot_data,len);
+    }
+    vao_binder.release();
+}
+
+void DrawElements(QOpenGLVertexArrayObject *vao,
+                  const QColor &color,
+                  GLsizei len, GLenum mode,
+                  PlotDataStruct *plot_data)
+{
+    QOpenGLVertexArrayObject::Binder vao_binder(vao);
+    {
+        plot_data->m_program.setUniformValue(plot_data->col,
+                                             color);
+
+        plot_data->functions->glDrawElements(
+                    mode,len,GL_UNSIGNED_INT,nullptr);
+        CountDraw(plot_data,len);
+    }
+    vao_binder.release();
+}
+
+void BufferAllocateSize(QOpenGLBuffer *pos,
+                        QOpenGLBuffer *index,
+                        int count)
+{
+    pos->create();
+    pos->bind();
+    pos->allocate(2*count*sizeof(GLfloat));
+    pos->release();
+
+    index->create();
+    index->bind();
+    index->allocate((2*count-2)*sizeof(GLuint));
+    index->release();
+}
+
+void SetScales(PlotDataStruct *plot_data)
+{
+    if (plot_data->logplot[HORIZONTAL])
+    {
+        plot_data->x_scale =  2.0 / log10(plot_data->log_top_range[BOTTOM] /
+                             plot_data->log_bottom_range[BOTTOM]);
+
+        plot_data->x_offset = -log10(plot_data->log_bottom_range[BOTTOM]) *
+                plot_data->x_scale;
+    }
+    else
+    {
+        plot_data->x_scale =  2.0 / (plot_data->top_range[BOTTOM] -
+                          plot_data->bottom_range[BOTTOM]);
+
+        plot_data->x_offset = -plot_data->bottom_range[BOTTOM] *
+                plot_data->x_scale;
+    }
+
+    if (plot_data->logplot[VERTICAL])
+    {
+        plot_data->y_scale =  -2.0 / log10(plot_data->log_top_range[LEFT]/
+                             plot_data->log_bottom_range[LEFT]);
+
+        plot_data->y_offset = -log10(plot_data->log_bottom_range[LEFT]) *
+                plot_data->y_scale;
+    }
+    else
+    {
+        plot_data->y_scale = -2.0 / (plot_data->top_range[LEFT] -
+                          plot_data->bottom_range[LEFT]);
+
+        plot_data->y_offset = -plot_data->bottom_range[LEFT] *
+                plot_data->y_scale;
+    }
+}
+
+void SetLogLabel(PlotDataStruct *plot_data, int side)
+{
+    int base  = ceil(log10(plot_data->log_bottom_range[side]));
+    int delta = floor(log10((plot_data->log_top_range[side])/
+                     (plot_data->log_bottom_range[side])));
+    double num;
+
+    for (int i = 0; i <= delta; i++)
+    {
+        num = pow(10,base+i);
+
+        (plot_data->tick_labels[side]).append(QString::number(num));
+    }
+}
+
+void SetLinLabel(PlotDataStruct *plot_data, int side)
+{
+    int base = ceil((plot_data->bottom_range[side])/
+                    (plot_data->tick_step[side]));
+    int delta = floor((plot_data->top_range[side]-plot_data->bottom_range[side])
+                      /(plot_data->tick_step[side]));
+
+    double num = base*(plot_data->tick_step[side]);
+
+    for (int i = 0; i <= delta; i++)
+    {
+        (plot_data->tick_labels[side]).append(QString::number(num));
+
+        num += plot_data->tick_step[side];
+    }
+}
+
+void SetLabels(PlotDataStruct *plot_data, int side)
+{
+    plot_data->tick_labels[side].clear();
+
+    if (side == LEFT || side == RIGHT)
+    {
+        if (plot_data->logplot[VERTICAL])
+        {
+            SetLogLabel(plot_data,side);
+        }
+        else
+        {
+            SetLinLabel(plot_data,side);
+        }
+    }
+    else
+    {
+        if (plot_data->logplot[HORIZONTAL])
+        {
+            SetLogLabel(plot_data,side);
+        }
+        else
+        {
+            SetLinLabel(plot_data,side);
+        }
+    }
+}
+
+void SetLabels(PlotDataStruct *plot_data)
+{
+    plot_data->dirty |= DIRTY_TEXT;
+
+    for (int i = 0; i < 4; i++)
+    {
+        SetLabels(plot_data,i);
+    }
+}
+
+void InitializeFrameData(PlotDataStruct *plot_data, const QRect &rect)
+{
+    plot_data->frame_vao.create();
+    plot_data->frame_vao.bind();
+    BufferAllocateSize(&(plot_data->frame_pos_buffer),
+                       &(plot_data->frame_index_buffer),4);
+    plot_data->frame_vao.release();
+
+    GLuint frame_index[4] = {
+        0,1,2,3
+    };
+
+    plot_data->frame_index_buffer.bind();
+    plot_data->frame_index_buffer.write(0,frame_index,4*sizeof(GLuint));
+    plot_data->frame_index_buffer.release();
+    SetFrameSize(plot_data,rect);
+
+    QOpenGLVertexArrayObject::Binder vao_binder(
+                &(plot_data->frame_vao));
+    {
+        plot_data->m_program.enableAttributeArray(plot_data->pos);
+
+        plot_data->frame_pos_buffer.bind();
+        plot_data->m_program.setAttributeBuffer(plot_data->pos,GL_FLOAT,0,2);
+
+        plot_data->frame_index_buffer.bind();
+    }
+    vao_binder.release();
+}
+
+void QOpenGL2DPlot::initializeGL()
+{
+    initializeOpenGLFunctions();
+
+    plot_data->context = QOpenGLContext::currentContext();
+    plot_data->functions = plot_data->context->functions();
+    this->glClearColor(1,1,1,0);
+
+    plot_data->m_program.addShaderFromSourceCode(
+                QOpenGLShader::Vertex, vertexShaderSource);
+    plot_data->m_program.addShaderFromSourceCode(
+                QOpenGLShader::Fragment, vertexFragmentSource);
+    plot_data->m_program.create();
+    plot_data->m_program.link();
+    plot_data->m_program.bindAttributeLocation("pos",0);
+    plot_data->m_program.bind();
+
+    plot_data->pos = plot_data->m_program.attributeLocation("pos");
+    plot_data->col = plot_data->m_program.uniformLocation("col");
+    plot_data->mat = plot_data->m_program.uniformLocation("matrix");
+    plot_data->log = plot_data->m_program.uniformLocation("logscale");
+    plot_data->log_floor = plot_data->m_program.uniformLocation("logfloor");
+    plot_data->origin = plot_data->m_program.uniformLocation("origin");
+    plot_data->marker = plot_data->m_program.uniformLocation("marker");
+    plot_data->point_size =
+            plot_data->m_program.uniformLocation("pointsize");
+
+    InitializeFrameData(plot_data, rect());
+
+    for (int i = 0; i < 4; i++)
+    {
+        plot_data->grid_vao[i].create();
+        plot_data->grid_buffer[i].create();
+
+        plot_data->sec_grid_vao[i].create();
+        plot_data->sec_grid_buffer[i].create();
+    }
+
+    plot_data->m_program.release();
+
+    plot_data->column_program.addShaderFromSourceCode(
+                QOpenGLShader::Vertex, columnVertexSource);
+    plot_data->column_program.addShaderFromSourceCode(
+                QOpenGLShader::Fragment, vertexFragmentSource);
+    plot_data->column_program.link();
+    plot_data->column_program.bind();
+
+    plot_data->column_x = plot_data->column_program.attributeLocation("xval");
+    plot_data->column_y = plot_data->column_program.attributeLocation("yval");
+    plot_data->column_col = plot_data->column_program.uniformLocation("col");
+    plot_data->column_mat = plot_data->column_program.uniformLocation("matrix");
+    plot_data->column_xmap =
+            plot_data->column_program.uniformLocation("xmap");
+    plot_data->column_log =
+            plot_data->column_program.uniformLocation("logscale");
+    plot_data->column_log_floor =
+            plot_data->column_program.uniformLocation("logfloor");
+    plot_data->column_origin =
+            plot_data->column_program.uniformLocation("origin");
+    plot_data->column_marker =
+            plot_data->column_program.uniformLocation("marker");
+    plot_data->column_point_size =
+            plot_data->column_program.uniformLocation("pointsize");
+
+    QVector<GLushort> sample_index(COLUMN_CHUNK_SIZE+1);
+    std::iota(sample_index.begin(),sample_index.end(),0);
+
+    plot_data->column_index_buffer.create();
+    plot_data->column_index_buffer.bind();
+    plot_data->column_index_buffer.allocate(
+                sample_index.constData(),
+                sample_index.count()*sizeof(GLushort));
+    plot_data->column_index_buffer.release();
+
+    plot_data->column_program.release();
+
+    plot_data->text_program.addShaderFromSourceCode(
+                QOpenGLShader::Vertex, textVertexSource);
+    plot_data->text_program.addShaderFromSourceCode(
+                QOpenGLShader::Fragment, textFragmentSource);
+    plot_data->text_program.link();
+    plot_data->text_program.bind();
+
+    plot_data->text_pos = plot_data->text_program.attributeLocation("pos");
+    plot_data->text_tex = plot_data->text_program.attributeLocation("tex");
+    plot_data->text_col = plot_data->text_program.uniformLocation("col");
+    plot_data->text_mat = plot_data->text_program.uniformLocation("matrix");
+    plot_data->text_program.setUniformValue("atlas",0);
+
+    plot_data->text_vao.create();
+    plot_data->text_buffer.create();
+
+    plot_data->text_program.release();
+
+    plot_data->layer_program.addShaderFromSourceCode(
+                QOpenGLShader::Vertex, layerVertexSource);
+    plot_data->layer_program.addShaderFromSourceCode(
+                QOpenGLShader::Fragment, layerFragmentSource);
+    plot_data->layer_program.link();
+    plot_data->layer_program.bind();
+
+    plot_data->layer_pos = plot_data->layer_program.attributeLocation("pos");
+    plot_data->layer_program.setUniformValue("layer",0);
+
+    static const GLfloat layer_quad[] = {0,0, 1,0, 0,1, 1,1};
+
+    plot_data->layer_vao.create();
+    plot_data->layer_buffer.create();
+
+    QOpenGLVertexArrayObject::Binder layer_binder(&(plot_data->layer_vao));
+    {
+        plot_data->layer_buffer.bind();
+        plot_data->layer_buffer.allocate(layer_quad,sizeof(layer_quad));
+        plot_data->layer_program.enableAttributeArray(plot_data->layer_pos);
+        plot_data->layer_program.setAttributeBuffer(plot_data->layer_pos,
+                                                    GL_FLOAT,0,2);
+        plot_data->layer_buffer.release();
+    }
+    layer_binder.release();
+
+    plot_data->layer_program.release();
+
+    // Timer queries need desktop GL 3.3 or ARB_timer_query
+    for (int i = 0; i < GPU_QUERIES; i++)
+    {
+        plot_data->gpu_query[i] = new QOpenGLTimerQuery;
+
+        if (!plot_data->gpu_query[i]->create())
+        {
+            delete plot_data->gpu_query[i];
+            plot_data->gpu_query[i] = nullptr;
+        }
+    }
+
+    plot_data->dirty = DIRTY_ALL;
+
+    plot_data->device = new QOpenGLPaintDevice();
+}
+
+int RelativeFontSize(const QString &text, const QRect &rect,
+                     float font_factor = 1.0)
+{
+    QFont font;
+    QFontMetrics metrics(font);
+
+    if (text.isEmpty())
+    {
+        return font.pointSize()*font_factor;
+    }
+
+    int size_h = rect.height();
+    int size_w = floor(rect.width()/(text.length()));
+    int size   = std::min<int>(size_h,size_w);
+
+    float font_size = font_factor*metrics.height();
+
+    if (size < font_size)
+    {
+        float rel_size = size/font_size;
+        size = round(font.pointSize()*rel_size*font_factor);
+
+        if (size <= 0)
+        {
+            size = 1;
+        }
+
+        return size;
+    }
+
+    return font.pointSize()*font_factor;
+}
+
+void SetFontRelativeSize(QPainter *painter, const QString &text,
+                         const QRect &rect, float font_factor = 1.0)
+{
+    QFont font;
+    font.setPointSize(RelativeFontSize(text,rect,font_factor));
+
+    painter->setFont(font);
+}
+
+void SetFontRelativeSize(QPainter *painter, const QString &text,
+                         const QRectF &rect, float font_factor = 1.0)
+{
+    SetFontRelativeSize(painter,text,rect.toRect(),font_factor);
+}
+
+void DrawTitle(PlotDataStruct *plot_data)
+{
+    if (!(plot_data->title_visible))
+    {
+        return;
+    }
+
+    SetFontRelativeSize(&(plot_data->painter),plot_data->title,
+                        plot_data->title_rect,2.0);
+
+    plot_data->painter.drawText(plot_data->title_rect,
+                                plot_data->title,
+                                QTextOption(Qt::AlignCenter));
+}
+
+void DrawLabels(PlotDataStruct *plot_data)
+{
+    int x_c;
+    int y_c;
+
+    QPainter *painter = &(plot_data->painter);
+
+    if (plot_data->labels_visible[LEFT])
+    {
+        x_c = floor(plot_data->labels_rect[LEFT].topLeft().x()+
+                    plot_data->viewport.width()/2.0);
+        y_c = floor(plot_data->labels_rect[LEFT].topLeft().y()+
+                    plot_data->viewport.height()/2.0);
+
+        painter->translate(x_c,y_c);
+        painter->rotate(-90);
+        painter->translate(-plot_data->labels_rect[LEFT].topLeft().x()+
+                          floor(plot_data->viewport.height()/2.0)-
+                          plot_data->labels_rect[LEFT].width(),
+                          -plot_data->labels_rect[LEFT].topLeft().y()-
+                          floor(plot_data->viewport.width()/2.0));
+
+        SetFontRelativeSize(painter,plot_data->labels[LEFT],
+                            plot_data->labels_rect[LEFT]);
+
+        painter->drawText(plot_data->labels_rect[LEFT],
+                         plot_data->labels[LEFT],
+                         QTextOption(Qt::AlignCenter));
+
+        painter->resetTransform();
+    }
+
+    if (plot_data->labels_visible[RIGHT])
+    {
+        x_c = floor(plot_data->labels_rect[RIGHT].topLeft().x()+
+                    plot_data->viewport.width()/2.0);
+        y_c = floor(plot_data->labels_rect[RIGHT].topLeft().y()+
+                    plot_data->viewport.height()/2.0);
+
+        painter->translate(x_c,y_c);
+        painter->rotate(-90);
+        painter->translate(-plot_data->labels_rect[RIGHT].topRight().x()+
+                          floor(plot_data->viewport.height()/2.0)-1,
+                          -plot_data->labels_rect[RIGHT].topRight().y()-
+                          floor(plot_data->viewport.width()/2.0));
+
+        SetFontRelativeSize(painter,plot_data->labels[RIGHT],
+                            plot_data->labels_rect[RIGHT]);
+
+        painter->drawText(plot_data->labels_rect[RIGHT],
+                          plot_data->labels[RIGHT],
+                         QTextOption(Qt::AlignCenter));
+
+        painter->resetTransform();
+    }
+
+    if (plot_data->labels_visible[BOTTOM])
+    {
+        painter->drawText(plot_data->labels_rect[BOTTOM],
+                          plot_data->labels[BOTTOM],
+                         QTextOption(Qt::AlignCenter));
+    }
+
+    if (plot_data->labels_visible[TOP])
+    {
+        painter->drawText(plot_data->labels_rect[TOP],
+                          plot_data->labels[TOP],
+                         QTextOption(Qt::AlignCenter));
+    }
+
+    //TICK LABELS
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (plot_data->tick_labels_visible[i])
+        {
+            QRect *tick_rects = plot_data->tick_labels_rects[i].data();
+            int count = plot_data->tick_labels_rects[i].count();
+            QString *tick_labels = plot_data->tick_labels[i].data();
+
+            for (int j = 0; j < count; j++)
+            {
+                SetFontRelativeSize(painter,tick_labels[j],
+                                    tick_rects[j]);
+
+                painter->drawText(tick_rects[j],tick_labels[j],
+                                  QTextOption(Qt::AlignCenter));
+            }
+        }
+    }
+}
+
+// QFontMetrics::width() is deprecated from Qt 5.11 on
+int GlyphAdvance(const QFontMetrics &metrics, QChar glyph)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    return metrics.horizontalAdvance(glyph);
+#else
+    return metrics.width(glyph);
+#endif
+}
+
+// Returns the atlas of the given font size, rasterizing it, or adding
+// the characters of text it is still missing.
+GlyphAtlasStruct *GlyphAtlas(PlotDataStruct *plot_data, int size,
+                             const QString &text)
+{
+    GlyphAtlasStruct *atlas = plot_data->glyph_atlas.value(size,nullptr);
+    QString glyphs;
+
+    if (atlas)
+    {
+        bool complete = true;
+
+        for (QChar c : text)
+        {
+            if (!atlas->advance.contains(c))
+            {
+                complete = false;
+                break;
+            }
+        }
+
+        if (complete)
+        {
+            return atlas;
+        }
+
+        glyphs = atlas->glyphs;
+
+        delete atlas->texture;
+        delete atlas;
+    }
+    else
+    {
+        for (int c = 32; c < 127; c++)
+        {
+            glyphs.append(QChar(c));
+        }
+    }
+
+    for (QChar c : text)
+    {
+        if (!glyphs.contains(c))
+        {
+            glyphs.append(c);
+        }
+    }
+
+    QFont font;
+    font.setPointSize(size);
+    QFontMetrics metrics(font);
+
+    int height = metrics.height();
+    int count = glyphs.length();
+    int x = 0;
+    int y = 0;
+
+    QVector<QPoint> origins(count);
+
+    for (int i = 0; i < count; i++)
+    {
+        int w = GlyphAdvance(metrics,glyphs[i]);
+
+        if (x+w+2 > GLYPH_ATLAS_WIDTH)
+        {
+            x = 0;
+            y += height+2;
+        }
+
+        origins[i] = QPoint(x+1,y+1);
+        x += w+2;
+    }
+
+    int image_h = y+height+2;
+
+    QImage image(GLYPH_ATLAS_WIDTH,image_h,
+                 QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    painter.setFont(font);
+    painter.setPen(Qt::white);
+
+    for (int i = 0; i < count; i++)
+    {
+        painter.drawText(origins[i].x(),origins[i].y()+metrics.ascent(),
+                         QString(glyphs[i]));
+    }
+
+    painter.end();
+
+    atlas = new GlyphAtlasStruct;
+    atlas->texture = new QOpenGLTexture(image,
+                                        QOpenGLTexture::DontGenerateMipMaps);
+    atlas->texture->setMinificationFilter(QOpenGLTexture::Linear);
+    atlas->texture->setMagnificationFilter(QOpenGLTexture::Linear);
+    atlas->texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+    atlas->glyphs = glyphs;
+    atlas->height = height;
+
+    for (int i = 0; i < count; i++)
+    {
+        int w = GlyphAdvance(metrics,glyphs[i]);
+
+        atlas->advance.insert(glyphs[i],w);
+        atlas->tex_rect.insert(glyphs[i],
+                               QRectF(origins[i].x()/double(GLYPH_ATLAS_WIDTH),
+                                      origins[i].y()/double(image_h),
+                                      w/double(GLYPH_ATLAS_WIDTH),
+                                      height/double(image_h)));
+    }
+
+    plot_data->glyph_atlas.insert(size,atlas);
+
+    return atlas;
+}
+
+void AppendTextVertex(QVector<GLfloat> &vertices, const QPointF &pos,
+                      double u, double v)
+{
+    vertices << pos.x() << pos.y() << u << v;
+}
+
+// Lays text out centered in rect, like QPainter::drawText() with
+// Qt::AlignCenter. Rotated text reads bottom to top, rect then being
+// given in the rotated frame as for the left and right labels.
+void AppendText(PlotDataStruct *plot_data,
+                QHash<int,QVector<GLfloat>> &vertices,
+                const QString &text, const QRect &rect,
+                float font_factor = 1.0, bool rotated = false)
+{
+    if (text.isEmpty())
+    {
+        return;
+    }
+
+    int size = RelativeFontSize(text,rect,font_factor);
+    GlyphAtlasStruct *atlas = GlyphAtlas(plot_data,size,text);
+    QVector<GLfloat> &target = vertices[size];
+
+    int width = 0;
+    int height = atlas->height;
+
+    for (QChar c : text)
+    {
+        width += atlas->advance.value(c);
+    }
+
+    double left, top;
+
+    if (rotated)
+    {
+        left = round(rect.x()+0.5*(rect.height()-height));
+        top  = round(rect.y()+0.5*(rect.width()+width));
+    }
+    else
+    {
+        left = round(rect.x()+0.5*(rect.width()-width));
+        top  = round(rect.y()+0.5*(rect.height()-height));
+    }
+
+    int pen = 0;
+
+    for (QChar c : text)
+    {
+        int advance = atlas->advance.value(c);
+        QRectF tex = atlas->tex_rect.value(c);
+        QPointF corner[4];
+
+        if (rotated)
+        {
+            corner[0] = QPointF(left,top-pen);
+            corner[1] = QPointF(left,top-pen-advance);
+            corner[2] = QPointF(left+height,top-pen-advance);
+            corner[3] = QPointF(left+height,top-pen);
+        }
+        else
+        {
+            corner[0] = QPointF(left+pen,top);
+            corner[1] = QPointF(left+pen+advance,top);
+            corner[2] = QPointF(left+pen+advance,top+height);
+            corner[3] = QPointF(left+pen,top+height);
+        }
+
+        AppendTextVertex(target,corner[0],tex.left(),tex.top());
+        AppendTextVertex(target,corner[1],tex.right(),tex.top());
+        AppendTextVertex(target,corner[2],tex.right(),tex.bottom());
+
+        AppendTextVertex(target,corner[0],tex.left(),tex.top());
+        AppendTextVertex(target,corner[2],tex.right(),tex.bottom());
+        AppendTextVertex(target,corner[3],tex.left(),tex.bottom());
+
+        pen += advance;
+    }
+}
+
+// Batches the title, labels and tick labels into one buffer, with a
+// range per font size. Only runs when the text or the layout changed.
+void SetTextGeometry(PlotDataStruct *plot_data)
+{
+    QHash<int,QVector<GLfloat>> vertices;
+
+    if (plot_data->title_visible)
+    {
+        AppendText(plot_data,vertices,plot_data->title,
+                   plot_data->title_rect,2.0);
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (plot_data->labels_visible[i])
+        {
+            AppendText(plot_data,vertices,plot_data->labels[i],
+                       plot_data->labels_rect[i],1.0,
+                       i == LEFT || i == RIGHT);
+        }
+
+        if (plot_data->tick_labels_visible[i])
+        {
+            int count = std::min<int>(plot_data->tick_labels[i].count(),
+                                      plot_data->tick_labels_rects[i].count());
+
+            for (int j = 0; j < count; j++)
+            {
+                AppendText(plot_data,vertices,plot_data->tick_labels[i][j],
+                           plot_data->tick_labels_rects[i][j]);
+            }
+        }
+    }
+
+    QMutableHashIterator<int,GlyphAtlasStruct*> it(plot_data->glyph_atlas);
+
+    while (it.hasNext())
+    {
+        it.next();
+
+        if (!vertices.contains(it.key()))
+        {
+            delete it.value()->texture;
+            delete it.value();
+            it.remove();
+        }
+    }
+
+    QVector<GLfloat> buffer;
+    plot_data->text_ranges.clear();
+
+    for (auto range = vertices.constBegin(); range != vertices.constEnd();
+         ++range)
+    {
+        TextRangeStruct text_range;
+        text_range.size  = range.key();
+        text_range.first = buffer.count()/4;
+        text_range.count = range.value().count()/4;
+
+        plot_data->text_ranges.append(text_range);
+        buffer += range.value();
+    }
+
+    QOpenGLShaderProgram *program = &(plot_data->text_program);
+
+    QOpenGLVertexArrayObject::Binder vao_binder(&(plot_data->text_vao));
+    {
+        program->enableAttributeArray(plot_data->text_pos);
+        program->enableAttributeArray(plot_data->text_tex);
+
+        plot_data->text_buffer.bind();
+        plot_data->text_buffer.allocate(buffer.constData(),
+                                        buffer.count()*sizeof(GLfloat));
+        CountUpload(plot_data,buffer.count()*sizeof(GLfloat));
+        program->setAttributeBuffer(plot_data->text_pos,GL_FLOAT,0,2,
+                                    4*sizeof(GLfloat));
+        program->setAttributeBuffer(plot_data->text_tex,GL_FLOAT,
+                                    2*sizeof(GLfloat),2,
+                                    4*sizeof(GLfloat));
+        plot_data->text_buffer.release();
+    }
+    vao_binder.release();
+
+    plot_data->dirty &= ~DIRTY_TEXT;
+}
+
+void DrawTextBatch(PlotDataStruct *plot_data)
+{
+    if (plot_data->text_ranges.isEmpty())
+    {
+        return;
+    }
+
+    QOpenGLFunctions *functions = plot_data->functions;
+    QOpenGLShaderProgram *program = &(plot_data->text_program);
+
+    functions->glEnable(GL_BLEND);
+    functions->glBlendFunc(GL_ONE,GL_ONE_MINUS_SRC_ALPHA);
+
+    program->bind();
+    program->setUniformValue(plot_data->text_mat,plot_data->matrix);
+    program->setUniformValue(plot_data->text_col,plot_data->text_color);
+
+    QOpenGLVertexArrayObject::Binder vao_binder(&(plot_data->text_vao));
+    {
+        for (const TextRangeStruct &range : plot_data->text_ranges)
+        {
+            plot_data->glyph_atlas.value(range.size)->texture->bind(0);
+            functions->glDrawArrays(GL_TRIANGLES,range.first,range.count);
+            CountDraw(plot_data,range.count);
+        }
+    }
+    vao_binder.release();
+
+    program->release();
+    functions->glDisable(GL_BLEND);
+}
+
+void DrawFrame(PlotDataStruct *plot_data)
+{
+    plot_data->functions->glDisable(GL_MULTISAMPLE);
+
+    if (plot_data->frame_visible)
+    {
+        plot_data->m_program.setUniformValue(plot_data->mat,
+                                             plot_data->matrix);
+
+        if (plot_data->frame_vao.isCreated())
+        {
+            DrawElements(&plot_data->frame_vao,
+                     plot_data->frame_color,
+                     4,GL_LINE_LOOP,plot_data);
+        }
+    }
+}
+
+void DrawGrid(PlotDataStruct *plot_data)
+{
+    int count;
+    plot_data->m_program.setUniformValue(plot_data->mat,
+                                         plot_data->grid_matrix);
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (plot_data->sec_grid_visible[i])
+        {
+            count = plot_data->total_sec_ticks_count[i];
+
+            plot_data->m_program.setUniformValue(plot_data->col,
+                                                 plot_data->sec_grid_color[i]);
+
+            DrawArrays(&(plot_data->sec_grid_vao[i]),
+                       plot_data->sec_grid_color[i],
+                       count,GL_LINES,plot_data);
+        }
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (plot_data->grid_visible[i])
+        {
+            count = 2*plot_data->ticks_count[i];
+
+            plot_data->m_program.setUniformValue(plot_data->col,
+                                                 plot_data->grid_color[i]);
+
+            DrawArrays(&(plot_data->grid_vao[i]),
+                       plot_data->grid_color[i],
+                       count,GL_LINES,plot_data);
+        }
+    }
+}
+
+void VisibleXRange(PlotDataStruct *plot_data, double &bot, double &top)
+{
+    if (plot_data->logplot[HORIZONTAL])
+    {
+        bot = plot_data->log_bottom_range[BOTTOM];
+        top = plot_data->log_top_range[BOTTOM];
+    }
+    else
+    {
+        bot = plot_data->bottom_range[BOTTOM];
+        top = plot_data->top_range[BOTTOM];
+    }
+}
+
+// Index span of the points of a sorted plot with X in [bot, top]
+void VisiblePointRange(const QVector<QPointF> &points,
+                       double bot, double top, int &from, int &to)
+{
+    from = std::lower_bound(points.constBegin(),points.constEnd(),bot,
+                            [](const QPointF &p, double x)
+                            { return p.x() < x; }) - points.constBegin();
+    to   = std::upper_bound(points.constBegin(),points.constEnd(),top,
+                            [](double x, const QPointF &p)
+                            { return x < p.x(); }) - points.constBegin();
+}
+
+void VisibleDataRange(PlotDataStruct *plot_data, int plot_index,
+                      int &from, int &to)
+{
+    const QVector<QPointF> &data = plot_data->data[plot_index];
+    PlotColumnStruct *column = plot_data->data_column[plot_index];
+
+    double bot, top;
+    VisibleXRange(plot_data,bot,top);
+
+    if (column && column->implicit_x)
+    {
+        from = qBound<double>(0,ceil((bot-column->x0)/column->dt),
+                              column->count);
+        to   = qBound<double>(0,floor((top-column->x0)/column->dt)+1,
+                              column->count);
+        return;
+    }
+
+    if (column)
+    {
+        int lo = 0;
+        int hi = column->count;
+
+        while (lo < hi)
+        {
+            int mid = (lo+hi)/2;
+
+            if (ColumnX(column,mid) < bot)
+            {
+                lo = mid+1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+
+        from = lo;
+        hi = column->count;
+
+        while (lo < hi)
+        {
+            int mid = (lo+hi)/2;
+
+            if (ColumnX(column,mid) <= top)
+            {
+                lo = mid+1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+
+        to = lo;
+        return;
+    }
+
+    VisiblePointRange(data,bot,top,from,to);
+}
+
+// Widens a visible span by one neighbour on each side, so segments that
+// cross the pane edges are still drawn and clipped by the scissor.
+void PadVisibleRange(int count, int &from, int &to)
+{
+    from = std::max<int>(from-1,0);
+    to   = std::min<int>(to+1,count);
+}
+
+// Picks the coarsest detail that still gives at least two vertices per
+// pixel column of the plot pane for the points currently in view.
+int SelectLodLevel(PlotDataStruct *plot_data, int plot_index)
+{
+    PlotLodStruct *lod = plot_data->data_lod[plot_index];
+    int levels = lod->levels.count();
+
+    if (!levels)
+    {
+        return 0;
+    }
+
+    int from, to;
+    VisibleDataRange(plot_data,plot_index,from,to);
+
+    double visible = double(to-from)/std::max<int>(
+                PointCount(plot_data,plot_index),1);
+    int width = std::max<int>(plot_data->plot_pane.width(),1);
+    int level = 0;
+
+    // Level n+1 draws lod->levels[n], a coarser one is only taken while
+    // it keeps both vertices of every column's min/max pair.
+    while (level < levels &&
+           visible*lod->levels[level].count() >= 2.0*width)
+    {
+        level++;
+    }
+
+    return level;
+}
+
+// The origin of a linear axis is added to the view offset in double, so
+// the translation left for the GPU is the distance from the origin to
+// the view and stays small however large the coordinates are.
+QMatrix4x4 PlotMatrix(PlotDataStruct *plot_data, const QPointF &origin)
+{
+    QMatrix4x4 matrix = plot_data->pane_matrix;
+
+    double x = -1+plot_data->x_offset;
+    double y =  1+plot_data->y_offset;
+
+    if (!plot_data->logplot[HORIZONTAL])
+    {
+        x += plot_data->x_scale*origin.x();
+    }
+
+    if (!plot_data->logplot[VERTICAL])
+    {
+        y += plot_data->y_scale*origin.y();
+    }
+
+    matrix.translate(x,y);
+    matrix.scale(plot_data->x_scale,plot_data->y_scale);
+
+    return matrix;
+}
+
+// Implicit X plots are drawn in chunks that fit the shared sample index
+// buffer, each chunk moves the Y attribute forward and starts its X at
+// an origin of its own, folded into the matrix in double like the plot
+// origin, so the sample index stays small.
+void DrawColumnSamples(PlotDataStruct *plot_data, int plot_index,
+                       int from, int to)
+{
+    PlotColumnStruct *column = plot_data->data_column[plot_index];
+    QOpenGLShaderProgram *program = &(plot_data->column_program);
+    int marker = plot_data->data_marker[plot_index];
+    GLenum mode = marker ? GL_POINTS : GL_LINE_STRIP;
+
+    const QPointF &origin = plot_data->data_origin[plot_index];
+
+    program->bind();
+    program->setUniformValue(plot_data->column_col,
+                             plot_data->data_color[plot_index]);
+    program->setUniformValue(plot_data->column_marker,GLfloat(marker));
+    program->setUniformValue(plot_data->column_point_size,
+                             plot_data->data_marker_size[plot_index]);
+    program->setUniformValue(plot_data->column_log,
+                GLfloat(plot_data->logplot[HORIZONTAL]),
+                GLfloat(plot_data->logplot[VERTICAL]));
+    program->setUniformValue(plot_data->column_log_floor,
+                GLfloat(log10(plot_data->log_bottom_range[BOTTOM])-1.0),
+                GLfloat(log10(plot_data->log_bottom_range[LEFT])-1.0));
+
+    QOpenGLVertexArrayObject::Binder vao_binder(
+                plot_data->data_vao[plot_index]);
+    {
+        if (!column->implicit_x)
+        {
+            program->setUniformValue(plot_data->column_mat,
+                                     PlotMatrix(plot_data,origin));
+            program->setUniformValue(plot_data->column_origin,
+                                     GLfloat(origin.x()),
+                                     GLfloat(origin.y()));
+            program->setUniformValue(plot_data->column_xmap,0.0f,1.0f);
+            plot_data->functions->glDrawArrays(mode,from,to-from);
+            CountDraw(plot_data,to-from);
+        }
+
+        for (int first = from; column->implicit_x && first < to;
+             first += COLUMN_CHUNK_SIZE)
+        {
+            column->y_buffer.bind();
+            program->setAttributeBuffer(plot_data->column_y,
+                                        SampleGLType(column->y_type),
+                                        first*GpuSampleSize(column->y_type),
+                                        1);
+            column->y_buffer.release();
+
+            QPointF chunk(column->x0+first*column->dt,origin.y());
+
+            program->setUniformValue(plot_data->column_mat,
+                                     PlotMatrix(plot_data,chunk));
+            program->setUniformValue(plot_data->column_origin,
+                                     GLfloat(chunk.x()),GLfloat(chunk.y()));
+            program->setUniformValue(plot_data->column_xmap,0.0f,
+                                     GLfloat(column->dt));
+
+            // Line chunks share their last vertex with the next chunk
+            int len = std::min<int>(COLUMN_CHUNK_SIZE+(marker ? 0 : 1),
+                                    to-first);
+
+            plot_data->functions->glDrawArrays(mode,0,len);
+            CountDraw(plot_data,len);
+        }
+    }
+    vao_binder.release();
+
+    plot_data->m_program.bind();
+}
+
+void DrawData(PlotDataStruct *plot_data)
+{
+    plot_data->functions->glEnable(GL_MULTISAMPLE);
+
+    bool sprites = !plot_data->context->isOpenGLES() &&
+            plot_data->context->format().profile() !=
+            QSurfaceFormat::CoreProfile;
+
+    if (!plot_data->context->isOpenGLES())
+    {
+        plot_data->functions->glEnable(GL_PROGRAM_POINT_SIZE);
+    }
+
+    if (sprites)
+    {
+        plot_data->functions->glEnable(GL_POINT_SPRITE);
+    }
+
+    // Non-positive values are clamped one decade below the bottom range
+    plot_data->m_program.setUniformValue(plot_data->log,
+                GLfloat(plot_data->logplot[HORIZONTAL]),
+                GLfloat(plot_data->logplot[VERTICAL]));
+    plot_data->m_program.setUniformValue(plot_data->log_floor,
+                GLfloat(log10(plot_data->log_bottom_range[BOTTOM])-1.0),
+                GLfloat(log10(plot_data->log_bottom_range[LEFT])-1.0));
+
+    double bot, top;
+    VisibleXRange(plot_data,bot,top);
+
+    for (int i = 0; i < plot_data->data.size(); i++)
+    {
+        int count = PointCount(plot_data,i);
+        int marker = plot_data->data_marker[i];
+        GLenum mode = marker ? GL_POINTS : GL_LINE_STRIP;
+
+        if (!(plot_data->data_visible[i]) || count < (marker ? 1 : 2))
+        {
+            continue;
+        }
+
+        plot_data->m_program.setUniformValue(plot_data->mat,
+                PlotMatrix(plot_data,plot_data->data_origin[i]));
+        plot_data->m_program.setUniformValue(plot_data->origin,
+                GLfloat(plot_data->data_origin[i].x()),
+                GLfloat(plot_data->data_origin[i].y()));
+        plot_data->m_program.setUniformValue(plot_data->marker,
+                                             GLfloat(marker));
+        plot_data->m_program.setUniformValue(plot_data->point_size,
+                                             plot_data->data_marker_size[i]);
+
+        if (IsRingPlot(plot_data,i))
+        {
+            // From the oldest slot up to the mirror of the first slot,
+            // then the points that wrapped around to the first slots.
+            int capacity = plot_data->ring_capacity[i];
+            int start = plot_data->ring_start[i];
+            int first_len = std::min<int>(count,capacity-start+1);
+
+            DrawArrays(plot_data->data_vao[i],
+                       plot_data->data_color[i],
+                       first_len,mode,plot_data,start);
+
+            if (count > first_len)
+            {
+                DrawArrays(plot_data->data_vao[i],
+                           plot_data->data_color[i],
+                           count-first_len+1,mode,plot_data);
+            }
+        }
+        else
+        {
+            // Sorted plots only draw the points in view, LOD levels of
+            // a sorted plot are sorted as well. Markers show every point,
+            // a min/max level would thin out a scatter cloud.
+            int level = marker ? 0 : SelectLodLevel(plot_data,i);
+            int from = 0;
+            int to = count;
+
+            if (level)
+            {
+                PlotLodStruct *lod = plot_data->data_lod[i];
+                const QVector<QPointF> &points = lod->levels[level-1];
+
+                VisiblePointRange(points,bot,top,from,to);
+                PadVisibleRange(points.count(),from,to);
+
+                DrawArrays(lod->vaos[level-1],
+                           plot_data->data_color[i],
+                           to-from,GL_LINE_STRIP,plot_data,from);
+                continue;
+            }
+
+            if (plot_data->data_sorted[i])
+            {
+                VisibleDataRange(plot_data,i,from,to);
+                PadVisibleRange(count,from,to);
+            }
+
+            if (IsColumnPlot(plot_data,i))
+            {
+                DrawColumnSamples(plot_data,i,from,to);
+            }
+            else
+            {
+                DrawArrays(plot_data->data_vao[i],
+                           plot_data->data_color[i],
+                           to-from,mode,plot_data,from);
+            }
+        }
+    }
+
+    plot_data->m_program.setUniformValue(plot_data->log,0.0f,0.0f);
+    plot_data->m_program.setUniformValue(plot_data->marker,0.0f);
+    plot_data->functions->glDisable(GL_MULTISAMPLE);
+
+    if (!plot_data->context->isOpenGLES())
+    {
+        plot_data->functions->glDisable(GL_PROGRAM_POINT_SIZE);
+    }
+
+    if (sprites)
+    {
+        plot_data->functions->glDisable(GL_POINT_SPRITE);
+    }
+}
+
+void SetProjectionMatrices(PlotDataStruct *plot_data,
+                           const QRect &rect)
+{
+    plot_data->pane_matrix.setToIdentity();
+    plot_data->pane_matrix.ortho(rect);
+    plot_data->pane_matrix.viewport(plot_data->plot_pane);
+
+    plot_data->grid_matrix = plot_data->pane_matrix;
+
+    plot_data->grid_matrix.translate(-1,1);
+    plot_data->grid_matrix.scale(2,-2);
+}
+
+// Points the view of a capture plot at the visible samples, padded by
+// half the visible width on each side so that panning does not move it
+// every frame. The finest summary level that fits CAPTURE_WINDOW_SIZE
+// is used; without a fitting level the view skips samples.
+void UpdateCaptureWindow(PlotDataStruct *plot_data, int plot_index)
+{
+    PlotCaptureStruct *link = plot_data->data_capture[plot_index];
+
+    if (!link)
+    {
+        return;
+    }
+
+    QOpenGL2DPlotCapture *capture = link->capture;
+    PlotColumnStruct *column = plot_data->data_column[plot_index];
+    qint64 count = capture->Count();
+    double dt = capture->Dt();
+
+    double bot, top;
+    VisibleXRange(plot_data,bot,top);
+
+    qint64 from = qBound<double>(0,floor((bot-capture->X0())/dt),count);
+    qint64 to   = qBound<double>(0,ceil((top-capture->X0())/dt)+1,count);
+    qint64 pad  = (to-from)/2;
+
+    qint64 bucket = 1;
+    int level = 0;
+
+    while (level < capture->SummaryLevels() &&
+           (level ? 2 : 1)*(to-from+2*pad)/bucket > CAPTURE_WINDOW_SIZE)
+    {
+        bucket *= capture->SummaryFactor();
+        level++;
+    }
+
+    if (level == link->level && from >= link->from && to <= link->to)
+    {
+        return;
+    }
+
+    from = std::max<qint64>(from-pad,0);
+    to   = std::min<qint64>(to+pad,count);
+
+    qint64 first = level ? 2*(from/bucket) : from;
+    qint64 last  = level ? 2*((to+bucket-1)/bucket) : to;
+
+    last = std::min<qint64>(last,capture->LevelCount(level));
+
+    qint64 step = std::max<qint64>(
+                (last-first+CAPTURE_WINDOW_SIZE-1)/CAPTURE_WINDOW_SIZE,1);
+    int size = SampleSize(capture->Type());
+
+    link->level = level;
+    link->from  = from;
+    link->to    = to;
+
+    // Summary pairs are spread over their bucket, low value first
+    column->y_data   = capture->Column(link->column,level)+first*size;
+    column->y_stride = step*size;
+    column->count    = (last-first+step-1)/step;
+    column->x0       = capture->X0()+(level ? first/2 : first)*bucket*dt;
+    column->dt       = (level ? bucket*dt/2 : dt)*step;
+
+    MarkDataDirty(plot_data,plot_index,0,column->count);
+}
+
+// A chunk of the dirty points of a plot to transform into pos, or with
+// no pos the LOD update of the whole dirty range of the plot, which
+// carries the sort state of the plot in and out.
+struct GeometryTaskStruct {
+    PlotDataStruct *plot_data;
+    int plot_index;
+    int from;
+    int to;
+    GLfloat *pos;
+    bool sorted;
+};
+
+// Tasks only read the samples of their plot and write its staging copy,
+// its CPU LOD levels or their own sort state, so they can run on any
+// thread.
+void RunGeometryTask(GeometryTaskStruct &task)
+{
+    PlotDataStruct *plot_data = task.plot_data;
+    int plot_index = task.plot_index;
+
+    if (task.pos)
+    {
+        TransformPoints(plot_data->data.at(plot_index).constData()+task.from,
+                        task.to-task.from,task.pos,
+                        plot_data->data_origin.at(plot_index));
+    }
+    else if (IsColumnPlot(plot_data,plot_index))
+    {
+        UpdateColumnLod(plot_data,plot_index,task.from,task.to,task.sorted);
+    }
+    else
+    {
+        UpdateDataLod(plot_data,plot_index,task.from,task.to,task.sorted);
+    }
+}
+
+// Buffers are grown and dirty ranges taken on the GL thread, then the
+// transforms, in chunks, and the LOD pyramids, one per plot, run on the
+// global thread pool once there is enough work, and the results are
+// uploaded back on the GL thread. A pyramid stays on one thread, each of
+// its levels is built from the previous one.
+void UpdateGeometry(PlotDataStruct *plot_data)
+{
+    int plots = plot_data->data.count();
+
+    QVector<int> from(plots);
+    QVector<int> to(plots);
+    QVector<QVector<GLfloat>> staging(plots);
+    QVector<GeometryTaskStruct> tasks;
+    QVector<GeometryTaskStruct> chunks;
+    qint64 work = 0;
+
+    DestroyReleasedObjects(plot_data);
+
+    // VAOs are created on the drawing context and belong to its thread
+    for (int i = 0; i < plots; i++)
+    {
+        if (!plot_data->data_vao[i])
+        {
+            plot_data->data_vao[i] = new QOpenGLVertexArrayObject;
+            plot_data->data_vao[i]->create();
+            plot_data->data_pos_buffer[i].create();
+
+            if (IsColumnPlot(plot_data,i))
+            {
+                plot_data->data_column[i]->y_buffer.create();
+                plot_data->data_column[i]->x_buffer.create();
+            }
+        }
+
+        UpdateCaptureWindow(plot_data,i);
+        PrepareDataPoints(plot_data,i,from[i],to[i]);
+
+        if (from[i] >= to[i])
+        {
+            continue;
+        }
+
+        tasks.append({plot_data,i,from[i],to[i],nullptr,
+                      plot_data->data_sorted.at(i)});
+        work += to[i]-from[i];
+
+        if (IsColumnPlot(plot_data,i))
+        {
+            continue;
+        }
+
+        staging[i].resize(2*(to[i]-from[i]));
+
+        for (int j = from[i]; j < to[i]; j += GEOMETRY_CHUNK_SIZE)
+        {
+            chunks.append({plot_data,i,j,
+                           std::min<int>(j+GEOMETRY_CHUNK_SIZE,to[i]),
+                           staging[i].data()+2*(j-from[i]),false});
+        }
+    }
+
+    // Whole pyramids first, they are the longest tasks
+    tasks += chunks;
+
+    if (work >= GEOMETRY_PARALLEL_MIN && tasks.count() > 1)
+    {
+        QtConcurrent::blockingMap(tasks,RunGeometryTask);
+    }
+    else
+    {
+        for (GeometryTaskStruct &task : tasks)
+        {
+            RunGeometryTask(task);
+        }
+    }
+
+    for (const GeometryTaskStruct &task : tasks)
+    {
+        if (!task.pos)
+        {
+            plot_data->data_sorted[task.plot_index] = task.sorted;
+        }
+    }
+
+    for (int i = 0; i < plots; i++)
+    {
+        UploadDataPoints(plot_data,i,from[i],to[i],staging[i].constData());
+    }
+}
+
+void ValidateState(PlotDataStruct *plot_data, const QRect &rect)
+{
+    // Anything but plot data shows in the decorations
+    if (plot_data->dirty)
+    {
+        plot_data->dirty |= DIRTY_DECORATIONS;
+    }
+
+    EnterStage(plot_data,QOpenGL2DPlot::LayoutStage);
+
+    plot_data->m_program.bind();
+
+    if (plot_data->dirty & DIRTY_LAYOUT)
+    {
+        SetFrameSize(plot_data,rect);
+        plot_data->dirty |= DIRTY_MATRICES | DIRTY_TICKS;
+    }
+
+    if (plot_data->dirty & DIRTY_MATRICES)
+    {
+        SetScales(plot_data);
+        SetProjectionMatrices(plot_data,rect);
+    }
+
+    if (plot_data->dirty & DIRTY_GRID)
+    {
+        SetGridPosition(plot_data);
+    }
+
+    if (plot_data->dirty & DIRTY_TICKS)
+    {
+        SetTickLabelsPositions(plot_data);
+    }
+
+    if (plot_data->dirty & DIRTY_LABELS)
+    {
+        SetLabels(plot_data);
+    }
+
+    EnterStage(plot_data,QOpenGL2DPlot::GeometryStage);
+    UpdateGeometry(plot_data);
+
+    plot_data->m_program.release();
+
+    if (plot_data->dirty & DIRTY_TEXT)
+    {
+        EnterStage(plot_data,QOpenGL2DPlot::TextStage);
+        SetTextGeometry(plot_data);
+    }
+
+    plot_data->dirty &= DIRTY_DECORATIONS;
+}
+
+void DrawUnderData(PlotDataStruct *plot_data, const QRect &rect)
+{
+    QOpenGLFunctions *functions = plot_data->functions;
+
+    EnterStage(plot_data,QOpenGL2DPlot::GridStage);
+    plot_data->m_program.bind();
+
+    functions->glEnable(GL_SCISSOR_TEST);
+    {
+        functions->glScissor(plot_data->plot_pane.x(),
+                             rect.height()-
+                             plot_data->plot_pane.bottomLeft().y(),
+                             plot_data->plot_pane.width()-2,
+                             plot_data->plot_pane.height()-2);
+
+        DrawGrid(plot_data);
+    }
+    functions->glDisable(GL_SCISSOR_TEST);
+
+    plot_data->m_program.release();
+}
+
+void DrawOverData(PlotDataStruct *plot_data)
+{
+    EnterStage(plot_data,QOpenGL2DPlot::FrameStage);
+    plot_data->m_program.bind();
+    DrawFrame(plot_data);
+    plot_data->m_program.release();
+
+    EnterStage(plot_data,QOpenGL2DPlot::TextStage);
+    DrawTextBatch(plot_data);
+}
+
+// Grid, frame and text only change with the state tracked by the dirty
+// flags, so they are drawn into two textures, one under and one over the
+// data, and each frame composites them around the data pass. Layers are
+// premultiplied, cleared to transparent. Returns false when framebuffer
+// objects are not available and decorations have to be drawn directly.
+bool UpdateDecorationLayers(PlotDataStruct *plot_data, const QRect &rect,
+                            const QSize &size, GLuint target)
+{
+    if (!QOpenGLFramebufferObject::hasOpenGLFramebufferObjects())
+    {
+        return false;
+    }
+
+    if (!(plot_data->dirty & DIRTY_DECORATIONS) && plot_data->under_layer)
+    {
+        return true;
+    }
+
+    QOpenGLFunctions *functions = plot_data->functions;
+
+    if (!plot_data->under_layer || plot_data->under_layer->size() != size)
+    {
+        delete plot_data->under_layer;
+        delete plot_data->over_layer;
+
+        plot_data->under_layer = new QOpenGLFramebufferObject(size);
+        plot_data->over_layer  = new QOpenGLFramebufferObject(size);
+    }
+
+    GLfloat clear[4];
+    functions->glGetFloatv(GL_COLOR_CLEAR_VALUE,clear);
+    functions->glClearColor(0,0,0,0);
+
+    plot_data->under_layer->bind();
+    functions->glClear(GL_COLOR_BUFFER_BIT);
+    DrawUnderData(plot_data,rect);
+
+    plot_data->over_layer->bind();
+    functions->glClear(GL_COLOR_BUFFER_BIT);
+    DrawOverData(plot_data);
+
+    functions->glBindFramebuffer(GL_FRAMEBUFFER,target);
+    functions->glClearColor(clear[0],clear[1],clear[2],clear[3]);
+
+    plot_data->dirty &= ~DIRTY_DECORATIONS;
+
+    return true;
+}
+
+void DrawLayer(PlotDataStruct *plot_data, QOpenGLFramebufferObject *layer)
+{
+    QOpenGLFunctions *functions = plot_data->functions;
+
+    functions->glEnable(GL_BLEND);
+    functions->glBlendFunc(GL_ONE,GL_ONE_MINUS_SRC_ALPHA);
+
+    plot_data->layer_program.bind();
+    functions->glActiveTexture(GL_TEXTURE0);
+    functions->glBindTexture(GL_TEXTURE_2D,layer->texture());
+
+    QOpenGLVertexArrayObject::Binder vao_binder(&(plot_data->layer_vao));
+    {
+        functions->glDrawArrays(GL_TRIANGLE_STRIP,0,4);
+        CountDraw(plot_data,4);
+    }
+    vao_binder.release();
+
+    plot_data->layer_program.release();
+    functions->glDisable(GL_BLEND);
+}
+
+void BeginFrameStats(PlotDataStruct *plot_data)
+{
+    QOpenGLTimerQuery *query = plot_data->gpu_query[plot_data->gpu_query_next];
+
+    plot_data->stats_stage = NO_STAGE;
+
+    if (query)
+    {
+        query->begin();
+    }
+}
+
+// Timer queries alternate and a result is only read once available, so
+// the GPU time lags the CPU times by a frame but never stalls the frame.
+void EndFrameStats(PlotDataStruct *plot_data)
+{
+    QOpenGL2DPlot::FrameStats &stats = plot_data->stats;
+    int next = plot_data->gpu_query_next;
+
+    EnterStage(plot_data,NO_STAGE);
+
+    if (plot_data->gpu_query[next])
+    {
+        plot_data->gpu_query[next]->end();
+        plot_data->gpu_query_pending[next] = true;
+
+        next = (next+1)%GPU_QUERIES;
+
+        if (plot_data->gpu_query_pending[next] &&
+            plot_data->gpu_query[next]->isResultAvailable())
+        {
+            stats.time[QOpenGL2DPlot::GpuStage] =
+                    plot_data->gpu_query[next]->waitForResult()*1E-9;
+            plot_data->gpu_query_pending[next] = false;
+        }
+
+        plot_data->gpu_query_next = next;
+    }
+
+    stats.time[QOpenGL2DPlot::TotalStage] =
+            plot_data->frame_clock.nsecsElapsed()*1E-9;
+
+    int slot = plot_data->stats_frames%plot_data->stats_window;
+
+    for (int i = 0; i < QOpenGL2DPlot::StageCount; i++)
+    {
+        plot_data->stats_history[i][slot] = stats.time[i];
+    }
+
+    plot_data->stats_frames++;
+    plot_data->last_stats = stats;
+
+    ClearFrameStats(stats);
+}
+
+void QOpenGL2DPlot::paintGL()
+{
+    PaintFrame(rect(),size()*devicePixelRatioF(),defaultFramebufferObject());
+}
+
+// Draws the plot laid out in rect into target, pixels is the size of
+// target in device pixels.
+void QOpenGL2DPlot::PaintFrame(const QRect &rect, const QSize &pixels,
+                               GLuint target)
+{
+    plot_data->frame_clock.restart();
+
+    if (plot_data->stats_enabled)
+    {
+        BeginFrameStats(plot_data);
+    }
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    DrainProducers();
+    ValidateState(plot_data,rect);
+
+    bool layers = UpdateDecorationLayers(plot_data,rect,pixels,target);
+
+    EnterStage(plot_data,GridStage);
+
+    if (layers)
+    {
+        DrawLayer(plot_data,plot_data->under_layer);
+    }
+    else
+    {
+        DrawUnderData(plot_data,rect);
+    }
+
+    EnterStage(plot_data,DataStage);
+    plot_data->m_program.bind();
+
+    glEnable(GL_SCISSOR_TEST);
+    {
+        glScissor(plot_data->plot_pane.x(),
+                  rect.height()-
+                  plot_data->plot_pane.bottomLeft().y(),
+                  plot_data->plot_pane.width()-2,
+                  plot_data->plot_pane.height()-2);
+
+        DrawData(plot_data);
+    }
+    glDisable(GL_SCISSOR_TEST);
+
+    plot_data->m_program.release();
+
+    EnterStage(plot_data,FrameStage);
+
+    if (layers)
+    {
+        DrawLayer(plot_data,plot_data->over_layer);
+    }
+    else
+    {
+        DrawOverData(plot_data);
+    }
+
+    if (plot_data->stats_enabled)
+    {
+        EndFrameStats(plot_data);
+        emit frameStats(plot_data->last_stats);
+    }
+}
+
+// Draws into target of the current context at size pixels, for the
+// offscreen renderer. The plot is set up in the first context it is
+// drawn with and can only be drawn with that one afterwards.
+bool QOpenGL2DPlot::RenderOffscreen(const QSize &size, GLuint target)
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+
+    if (!context || size.isEmpty())
+    {
+        return false;
+    }
+
+    if (!plot_data->context)
+    {
+        initializeGL();
+    }
+    else if (plot_data->context != context)
+    {
+#ifdef QT_DEBUG
+        ErrorHandle(CONTEXT_ERROR);
+#endif
+        return false;
+    }
+
+    QRect rect(QPoint(0,0),size);
+
+    if (rect != plot_data->viewport)
+    {
+        plot_data->device->setSize(size);
+        plot_data->dirty |= DIRTY_LAYOUT;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER,target);
+    glViewport(0,0,size.width(),size.height());
+
+    PaintFrame(rect,size,target);
+
+    return true;
+}
+
+void QOpenGL2DPlot::resizeGL(int w,int h)
+{
+    QSize size(w,h);
+
+    this->resize(size);
+    plot_data->device->setSize(size);
+
+    plot_data->dirty |= DIRTY_LAYOUT;
+}
+
+void QOpenGL2DPlot::hideFrame(bool hide)
+{
+    plot_data->frame_visible = !hide;
+    Invalidate(plot_data,DIRTY_DECORATIONS);
+}
+
+void QOpenGL2DPlot::showFrame(bool show)
+{
+    hideFrame(!show);
+}
+
+bool QOpenGL2DPlot::isFrameVisible() const
+{
+    return plot_data->frame_visible;
+}
+
+bool QOpenGL2DPlot::isFrameHidden() const
+{
+    return !(plot_data->frame_visible);
+}
+
+void QOpenGL2DPlot::addPlot(int before)
+{
+    addPlots(1,before);
+}
+
+void QOpenGL2DPlot::addPlots(int count, int before)
+{
+    QVector<QVector<QPointF>> point_vector;
+    point_vector.resize(count);
+
+    addPlots(std::move(point_vector),before);
+}
+
+void QOpenGL2DPlot::addPlots(const QVector<QVector<QPointF>> &data,
+                             int before)
+{
+    QVector<QVector<QPointF>> copy = data;
+
+    addPlots(std::move(copy),before);
+}
+
+// The point vectors are swapped in, the caller's buffers are adopted
+// without copying or detaching.
+void QOpenGL2DPlot::addPlots(QVector<QVector<QPointF>> &&data, int before)
+{
+#ifdef QT_DEBUG
+    Error error = NO_ERRORS;
+    CheckPlotIndex(before,plot_data->data,error);
+    ErrorHandle(error);
+#endif
+
+    int data_count = data.count();
+    int it;
+
+    for (int i = 0; i < data_count; i++)
+    {
+        if (plot_data->data.size() == 0)
+        {
+            it = 0;
+        }
+        else
+        {
+            it = before+i+1;
+        }
+
+        plot_data->data.insert(it,QVector<QPointF>());
+        plot_data->data[it].swap(data[i]);
+        plot_data->data_color.insert(it,DEFAULT_PLOT_COLOR);
+        plot_data->data_visible.insert(it,DEFAULT_PLOT_VISIBLE);
+        plot_data->data_pos_buffer.insert(
+                    it,QOpenGLBuffer(QOpenGLBuffer::VertexBuffer));
+        plot_data->data_capacity.insert(it,0);
+        plot_data->data_dirty_begin.insert(it,0);
+        plot_data->data_dirty_end.insert(it,plot_data->data[it].count());
+        plot_data->ring_capacity.insert(it,0);
+        plot_data->ring_start.insert(it,0);
+        plot_data->ring_count.insert(it,0);
+        plot_data->ring_pending.insert(it,0);
+        plot_data->data_sorted.insert(it,true);
+        plot_data->data_lod.insert(it,new PlotLodStruct);
+        plot_data->data_producer.insert(it,nullptr);
+        plot_data->data_column.insert(it,nullptr);
+        plot_data->data_capture.insert(it,nullptr);
+        plot_data->data_origin.insert(it,QPointF(0,0));
+        plot_data->data_marker.insert(it,DEFAULT_PLOT_MARKER);
+        plot_data->data_marker_size.insert(it,DEFAULT_MARKER_SIZE);
+
+        plot_data->data_vao.insert(it,nullptr);
+    }
+
+    data.clear();
+
+    Invalidate(plot_data,DIRTY_NONE);
+}
+
+void QOpenGL2DPlot::addPoint(int plot_index, const QPointF &point,
+                             int pos)
+{
+#ifdef QT_DEBUG
+    Error error = NO_ERRORS;
+    CheckPlotIndex(plot_index,plot_data->data,error);
+    ErrorHandle(error);
+#endif
+
+    if (IsRingPlot(plot_data,plot_index))
+    {
+        PushRingPoint(plot_data,plot_index,point);
+    }
+    else
+    {
+        InsertPoints(plot_data,plot_index,&point,1,pos);
+    }
+
+    Invalidate(plot_data,DIRTY_NONE);
+}
+
+void QOpenGL2DPlot::addPoints(int plot_index,
+                              const QVector<QPointF> &points, int pos)
+{
+#ifdef QT_DEBUG
+    Error error = NO_ERRORS;
+    CheckPlotIndex(plot_index,plot_data->data,error);
+    ErrorHandle(error);
+#endif
+
+    if (IsRingPlot(plot_data,plot_index))
+    {
+        PushRingPoints(plot_data,plot_index,points.constData(),
+                       points.count());
+    }
+    else
+    {
+        InsertPoints(plot_data,plot_index,points.constData(),
+                     points.count(),pos);
+    }
+
+    Invalidate(plot_data,DIRTY_NONE);
+}
+
+// An empty plot takes over the caller's buffer as is.
+void QOpenGL2DPlot::addPoints(int plot_index, QVector<QPointF> &&points,
+                              int pos)
+{
+#ifdef QT_DEBUG
+    Error error = NO_ERRORS;
+    CheckPlotIndex(plot_index,plot_data->data,error);
+    ErrorHandle(error);
+#endif
+
+    if (!IsRingPlot(plot_data,plot_index) &&
+        !IsColumnPlot(plot_data,plot_index) &&
+        plot_data->data[plot_index].isEmpty())
+    {
+        plot_data->data[plot_index].swap(points);
+        points.clear();
+
+        MarkDataDirty(plot_data,plot_index,0,
+                      plot_data->data[plot_index].count());
+
+        Invalidate(plot_data,DIRTY_NONE);
+        return;
+    }
+
+    addPoints(plot_index,points,pos);
+    points.clear();
+}
+
+void QOpenGL2DPlot::appendPoint(int plot_index, const QPointF &point)
+{
+    addPoint(plot_index,point,PlotSize(plot_index));
+}
+
+void QOpenGL2DPlot::appendPoints(int plot_index,
+                                 const QVector<QPointF> &points)
+{
+    addPoints(plot_index,points,PlotSize(plot_index));
+}
+
+void QOpenGL2DPlot::appendPoints(int plot_index, QVector<QPointF> &&points)
+{
+    addPoints(plot_index,std::move(points),PlotSize(plot_index));
+}
+
+void QOpenGL2DPlot::setPoint(int plot_index, const QPointF &point,
+                             int index)
+{
+#ifdef QT_DEBUG
+    Error error = NO_ERRORS;
+    CheckPlotIndex(plot_index,plot_data->data,error);
+    CheckIndex(index,PointCount(plot_data,plot_index),error);
+    ErrorHandle(error);
+#endif
+
+    if (IsColumnPlot(plot_data,plot_index))
+    {
+        SetColumnPoints(plot_data,plot_index,&point,1,index);
+        Invalidate(plot_data,DIRTY_NONE);
+        return;
+    }
+
+    int slot = PointSlot(plot_data,plot_index,index);
+    plot_data->data[plot_index][slot] = point;
+
+    MarkDataDirty(plot_data,plot_index,slot,slot+1);
+    Invalidate(plot_data,DIRTY_NONE);
+}
+
+void QOpenGL2DPlot::setPoints(int plot_index,
+                              const QVector<QPointF> &points, int index)
+{
+#ifdef QT_DEBUG
+    Error error = NO_ERRORS;
+    CheckPlotIndex(plot_index,plot_data->data,error);
+    CheckIndex(index,PointCount(plot_data,plot_index),error);
+    ErrorHandle(error);
+#endif
+
+    int count = points.count();
+
+    if (IsColumnPlot(plot_data,plot_index))
+    {
+        SetColumnPoints(plot_data,plot_index,points.constData(),count,
+                        index);
+        Invalidate(plot_data,DIRTY_NONE);
+        return;
+    }
+
+    if (IsRingPlot(plot_data,plot_index))
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (index+i < plot_data->ring_count[plot_index])
+            {
+                int slot = PointSlot(plot_data,plot_index,index+i);
+                plot_data->data[plot_index][slot] = points[i];
+
+                MarkDataDirty(plot_data,plot_index,slot,slot+1);
+            }
+            else
+            {
+                PushRingPoint(plot_data,plot_index,points[i]);
+            }
+        }
+
+        Invalidate(plot_data,DIRTY_NONE);
+        return;
+    }
 
-    for (int i = 0; i < plot_data->data.size(); i++)
+    if (plot_data->data[plot_index].count() < index+count)
     {
-        if (plot_data->data_visible[i])
-        {
-            DrawElements(plot_data->data_vao[i],
-                         plot_data->data_color[i],
-                         2*(plot_data->data[i].count()-1),
-                         GL_LINES,plot_data);
-        }
+        plot_data->data[plot_index].resize(index+count);
     }
-    plot_data->functions->glDisable(GL_MULTISAMPLE);
+
+    for (int i = 0; i < count; i++)
+    {
+        plot_data->data[plot_index][index+i] = points[i];
+    }
+
+    MarkDataDirty(plot_data,plot_index,index,index+count);
+    Invalidate(plot_data,DIRTY_NONE);
 }
 
-void QOpenGL2DPlot::paintGL()
+void QOpenGL2DPlot::setPlotCapacity(int plot_index, int capacity)
 {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+#ifdef QT_DEBUG
+    Error error = NO_ERRORS;
+    CheckPlotIndex(plot_index,plot_data->data,error);
+    ErrorHandle(error);
+#endif
 
-    plot_data->painter.begin(this);
+    int count = PointCount(plot_data,plot_index);
+    int first = 0;
 
-    DrawTitle(plot_data);       //SLOOOOOOW AS FUCK!!!!
-    DrawLabels(plot_data);      //SLOOOOOOW AS FUCK!!!!
+    if (capacity > 0 && count > capacity)
+    {
+        first = count-capacity;
+        count = capacity;
+    }
 
-    plot_data->painter.beginNativePainting();
-    plot_data->m_program.bind();
+    QVector<QPointF> points(std::max<int>(capacity,count));
 
-    glEnable(GL_SCISSOR_TEST);
+    for (int i = 0; i < count; i++)
     {
-        glScissor(plot_data->plot_pane.x(),
-                  rect().height()-
-                  plot_data->plot_pane.bottomLeft().y(),
-                  plot_data->plot_pane.width()-2,
-                  plot_data->plot_pane.height()-2);
+        points[i] = PointAt(plot_data,plot_index,first+i);
+    }
 
-        DrawGrid(plot_data);
-        DrawData(plot_data);
+    // Ring buffers hold points, column plots are converted back
+    if (IsColumnPlot(plot_data,plot_index))
+    {
+        ResetPlotStorage(plot_data,plot_index);
     }
-    glDisable(GL_SCISSOR_TEST);
 
-    DrawFrame(plot_data);
+    plot_data->data[plot_index] = points;
+    plot_data->ring_capacity[plot_index] = std::max<int>(capacity,0);
+    plot_data->ring_start[plot_index]    = 0;
+    plot_data->ring_count[plot_index]    = count;
+    plot_data->ring_pending[plot_index]  = 0;
 
-    plot_data->m_program.release();
-    plot_data->painter.endNativePainting();
-    plot_data->painter.end();
+    // Buffers are reallocated with the new layout on the next upload
+    plot_data->data_capacity[plot_index] = 0;
+    MarkDataDirty(plot_data,plot_index,0,count);
 
-    glFinish();
-    context()->swapBuffers(context()->surface());
-    doneCurrent();
+    Invalidate(plot_data,DIRTY_NONE);
 }
 
-void SetProjectionMatrices(PlotDataStruct *plot_data,
-                           const QRect &rect)
+int QOpenGL2DPlot::PlotCapacity(int plot_index) const
 {
-    plot_data->data_matrix.setToIdentity();
-    plot_data->data_matrix.ortho(rect);
-    plot_data->data_matrix.viewport(plot_data->plot_pane);
-
-    plot_data->grid_matrix = plot_data->data_matrix;
-
-    plot_data->data_matrix.translate(-1+plot_data->x_offset,
-                                      1+plot_data->y_offset);
-    plot_data->data_matrix.scale(plot_data->x_scale,
-                                 plot_data->y_scale);
-
-    plot_data->grid_matrix.translate(-1,1);
-    plot_data->grid_matrix.scale(2,-2);
+    return plot_data->ring_capacity[plot_index];
 }
 
-void QOpenGL2DPlot::resizeGL(int w,int h)
+void QOpenGL2DPlot::setSamples(int plot_index, const void *y,
+                               SampleType type, int count,
+                               double x0, double dt)
 {
-    QSize size(w,h);
+#ifdef QT_DEBUG
+    Error error = NO_ERRORS;
+    CheckPlotIndex(plot_index,plot_data->data,error);
+    ErrorHandle(error);
+#endif
 
-    this->resize(size);
-    plot_data->device->setSize(size);
+    PlotColumnStruct *column = ColumnStorage(plot_data,plot_index,
+                                             type,type,true);
 
-    SetFrameSize(plot_data,rect());
-    SetTickLabelsPositions(plot_data);
-    SetProjectionMatrices(plot_data,rect());
-}
+    column->x0       = x0;
+    column->dt       = dt;
+    column->count    = count;
+    column->external = false;
+    column->y_stride = SampleSize(type);
+    column->y        = QByteArray(static_cast<const char*>(y),
+                                  count*SampleSize(type));
 
-void QOpenGL2DPlot::hideFrame(bool hide)
-{
-    plot_data->frame_visible = !hide;
+    CountPoints(plot_data,count);
+    MarkDataDirty(plot_data,plot_index,0,count);
+    Invalidate(plot_data,DIRTY_NONE);
 }
 
-void QOpenGL2DPlot::showFrame(bool show)
+void QOpenGL2DPlot::setSamples(int plot_index,
+                               const void *x, SampleType x_type,
+                               const void *y, SampleType y_type,
+                               int count)
 {
-    hideFrame(!show);
-}
+#ifdef QT_DEBUG
+    Error error = NO_ERRORS;
+    CheckPlotIndex(plot_index,plot_data->data,error);
+    ErrorHandle(error);
+#endif
 
-bool QOpenGL2DPlot::isFrameVisible() const
-{
-    return plot_data->frame_visible;
+    PlotColumnStruct *column = ColumnStorage(plot_data,plot_index,
+                                             y_type,x_type,false);
+
+    column->count    = count;
+    column->external = false;
+    column->y_stride = SampleSize(y_type);
+    column->x_stride = SampleSize(x_type);
+    column->y        = QByteArray(static_cast<const char*>(y),
+                                  count*SampleSize(y_type));
+    column->x        = QByteArray(static_cast<const char*>(x),
+                                  count*SampleSize(x_type));
+
+    CountPoints(plot_data,count);
+    MarkDataDirty(plot_data,plot_index,0,count);
+    Invalidate(plot_data,DIRTY_NONE);
 }
 
-bool QOpenGL2DPlot::isFrameHidden() const
+void QOpenGL2DPlot::appendSamples(int plot_index, const void *y,
+                                  int count)
 {
-    return !(plot_data->frame_visible);
-}
+#ifdef QT_DEBUG
+    Error error = NO_ERRORS;
+    CheckPlotIndex(plot_index,plot_data->data,error);
 
-void QOpenGL2DPlot::addPlot(int before)
-{
-    addPlots(1,before);
-}
+    if (!hasImplicitX(plot_index))
+    {
+        error |= PLOT_TYPE_ERROR;
+    }
 
-void QOpenGL2DPlot::addPlots(int count, int before)
-{
-    QVector<QVector<QPointF>> point_vector;
-    point_vector.resize(count);
+    ErrorHandle(error);
+#endif
 
-    addPlots(point_vector,before);
+    PlotColumnStruct *column = plot_data->data_column[plot_index];
+    int from = column->count;
+
+    DetachPlot(plot_data,plot_index);
+
+    column->y.append(static_cast<const char*>(y),
+                     count*SampleSize(column->y_type));
+    column->count += count;
+
+    CountPoints(plot_data,count);
+    MarkDataDirty(plot_data,plot_index,from,from+count);
+    Invalidate(plot_data,DIRTY_NONE);
 }
 
-void QOpenGL2DPlot::addPlots(const QVector<QVector<QPointF>> data,
-                             int before)
+void QOpenGL2DPlot::appendSamples(int plot_index, const void *x,
+                                  const void *y, int count)
 {
 #ifdef QT_DEBUG
     Error error = NO_ERRORS;
-    CheckPlotIndex(before,plot_data->data,error);
-    ErrorHandle(error);
-#endif
-
-    int data_count = data.count();
-    int it;
+    CheckPlotIndex(plot_index,plot_data->data,error);
 
-    if (plot_data->m_program.isLinked())
+    if (!IsColumnPlot(plot_data,plot_index) || hasImplicitX(plot_index))
     {
-        makeCurrent();
-        plot_data->m_program.bind();
+        error |= PLOT_TYPE_ERROR;
     }
 
-    for (int i = 0; i < data_count; i++)
-    {
-        if (plot_data->data.size() == 0)
-        {
-            it = 0;
-        }
-        else
-        {
-            it = before+i+1;
-        }
+    ErrorHandle(error);
+#endif
 
-        plot_data->data.insert(it,data[i]);
-        plot_data->data_color.insert(it,DEFAULT_PLOT_COLOR);
-        plot_data->data_visible.insert(it,DEFAULT_PLOT_VISIBLE);
-        plot_data->data_pos_buffer.insert(
-                    it,QOpenGLBuffer(QOpenGLBuffer::VertexBuffer));
-        plot_data->data_index_buffer.insert(
-                    it,QOpenGLBuffer(QOpenGLBuffer::IndexBuffer));
+    PlotColumnStruct *column = plot_data->data_column[plot_index];
+    int from = column->count;
 
-        QOpenGLVertexArrayObject *vao = new QOpenGLVertexArrayObject(this);
+    DetachPlot(plot_data,plot_index);
 
-        plot_data->data_vao.insert(it,vao);
+    column->y.append(static_cast<const char*>(y),
+                     count*SampleSize(column->y_type));
+    column->x.append(static_cast<const char*>(x),
+                     count*SampleSize(column->x_type));
+    column->count += count;
 
-        if (plot_data->m_program.isLinked())
-        {
+    CountPoints(plot_data,count);
+    MarkDataDirty(plot_data,plot_index,from,from+count);
+    Invalidate(plot_data,DIRTY_NONE);
+}
 
-            plot_data->data_vao[it]->create();
+void QOpenGL2DPlot::setSampleSpacing(int plot_index, double x0, double dt)
+{
+#ifdef QT_DEBUG
+    Error error = NO_ERRORS;
+    CheckPlotIndex(plot_index,plot_data->data,error);
 
-            QOpenGLVertexArrayObject::Binder vao_binder(
-                        plot_data->data_vao[it]);
-            {
-                plot_data->data_pos_buffer[it].create();
-                plot_data->data_index_buffer[it].create();
-            }
-            vao_binder.release();
-        }
+    if (!hasImplicitX(plot_index))
+    {
+        error |= PLOT_TYPE_ERROR;
     }
 
-    if (plot_data->m_program.isLinked())
+    ErrorHandle(error);
+#endif
+
+    PlotColumnStruct *column = plot_data->data_column[plot_index];
+
+    column->x0 = x0;
+    column->dt = dt;
+
+    // Only the pyramid depends on X, but it is rebuilt from the upload
+    MarkDataDirty(plot_data,plot_index,0,column->count);
+    Invalidate(plot_data,DIRTY_NONE);
+}
+
+QOpenGL2DPlot::SampleType QOpenGL2DPlot::PlotSampleType(
+        int plot_index) const
+{
+    if (IsColumnPlot(plot_data,plot_index))
     {
-        plot_data->m_program.release();
-        doneCurrent();
+        return plot_data->data_column[plot_index]->y_type;
     }
+
+    return Double;
 }
 
-void QOpenGL2DPlot::addPoint(int plot_index, const QPointF &point,
-                             int pos)
+bool QOpenGL2DPlot::hasImplicitX(int plot_index) const
+{
+    return IsColumnPlot(plot_data,plot_index) &&
+            plot_data->data_column[plot_index]->implicit_x;
+}
+
+// Views read the caller's buffer at upload time, in paintGL(). It must
+// stay valid until the plot is given other data, and the ranges passed
+// to updateSamples() must not be written while the widget paints.
+void QOpenGL2DPlot::setSampleView(int plot_index, const void *y,
+                                  SampleType type, int count, int stride,
+                                  double x0, double dt)
 {
 #ifdef QT_DEBUG
     Error error = NO_ERRORS;
@@ -1700,11 +4662,26 @@ void QOpenGL2DPlot::addPoint(int plot_index, const QPointF &point,
     ErrorHandle(error);
 #endif
 
-    plot_data->data[plot_index].insert(pos,point);
+    PlotColumnStruct *column = ColumnStorage(plot_data,plot_index,
+                                             type,type,true);
+
+    column->x0       = x0;
+    column->dt       = dt;
+    column->count    = count;
+    column->external = true;
+    column->y_data   = static_cast<const char*>(y);
+    column->y_stride = stride > 0 ? stride : SampleSize(type);
+    column->y.clear();
+
+    MarkDataDirty(plot_data,plot_index,0,count);
+    Invalidate(plot_data,DIRTY_NONE);
 }
 
-void QOpenGL2DPlot::addPoints(int plot_index,
-                              const QVector<QPointF> &points, int pos)
+void QOpenGL2DPlot::setSampleView(int plot_index,
+                                  const void *x, SampleType x_type,
+                                  int x_stride,
+                                  const void *y, SampleType y_type,
+                                  int y_stride, int count)
 {
 #ifdef QT_DEBUG
     Error error = NO_ERRORS;
@@ -1712,76 +4689,224 @@ void QOpenGL2DPlot::addPoints(int plot_index,
     ErrorHandle(error);
 #endif
 
-    int count = points.count();
+    PlotColumnStruct *column = ColumnStorage(plot_data,plot_index,
+                                             y_type,x_type,false);
 
-    for (int i = 0; i < count; i++)
+    column->count    = count;
+    column->external = true;
+    column->y_data   = static_cast<const char*>(y);
+    column->x_data   = static_cast<const char*>(x);
+    column->y_stride = y_stride > 0 ? y_stride : SampleSize(y_type);
+    column->x_stride = x_stride > 0 ? x_stride : SampleSize(x_type);
+    column->y.clear();
+    column->x.clear();
+
+    MarkDataDirty(plot_data,plot_index,0,count);
+    Invalidate(plot_data,DIRTY_NONE);
+}
+
+// Tells the widget which samples of a view changed and, when count is
+// not negative, how many samples the view holds now. A negative "to"
+// stands for the end of the view.
+void QOpenGL2DPlot::updateSamples(int plot_index, int from, int to,
+                                  int count)
+{
+#ifdef QT_DEBUG
+    Error error = NO_ERRORS;
+    CheckPlotIndex(plot_index,plot_data->data,error);
+
+    if (!isSampleView(plot_index))
+    {
+        error |= PLOT_TYPE_ERROR;
+    }
+
+    ErrorHandle(error);
+#endif
+
+    PlotColumnStruct *column = plot_data->data_column[plot_index];
+
+    if (count >= 0)
     {
-        plot_data->data[plot_index].insert(pos,points[i]);
+        column->count = count;
     }
 
-    if (plot_data->m_program.isLinked())
+    if (to < 0)
     {
-        SetDataPointsPosition(plot_data,plot_index);
+        to = column->count;
     }
+
+    MarkDataDirty(plot_data,plot_index,from,to);
+    Invalidate(plot_data,DIRTY_NONE);
 }
 
-void QOpenGL2DPlot::setPoint(int plot_index, const QPointF &point,
-                             int index)
+// The capture must stay open while the plot shows it. Only the part of
+// the file in view is uploaded, at the summary level that fits it.
+void QOpenGL2DPlot::setCapture(int plot_index,
+                               QOpenGL2DPlotCapture *capture, int column)
 {
 #ifdef QT_DEBUG
     Error error = NO_ERRORS;
     CheckPlotIndex(plot_index,plot_data->data,error);
-    CheckIndex(index,plot_data->data[plot_index],error);
+
+    if (!capture->isOpen() || column >= capture->Columns())
+    {
+        error |= INDEX_ERROR;
+    }
+
     ErrorHandle(error);
 #endif
 
-    plot_data->data[plot_index][index] = point;
+    PlotColumnStruct *plot_column = ColumnStorage(plot_data,
+                                                  plot_index,
+                                                  capture->Type(),
+                                                  capture->Type(),true);
+
+    plot_column->external = true;
+    plot_column->count    = 0;
+    plot_column->y_data   = nullptr;
+    plot_column->y.clear();
+
+    PlotCaptureStruct *link = new PlotCaptureStruct;
+    link->capture = capture;
+    link->column  = column;
+    link->level   = -1;
+    link->from    = 0;
+    link->to      = 0;
+
+    plot_data->data_capture[plot_index] = link;
+
+    Invalidate(plot_data,DIRTY_NONE);
 }
 
-void QOpenGL2DPlot::setPoints(int plot_index,
-                              const QVector<QPointF> &points, int index)
+bool QOpenGL2DPlot::isSampleView(int plot_index) const
+{
+    return IsColumnPlot(plot_data,plot_index) &&
+            plot_data->data_column[plot_index]->external;
+}
+
+QOpenGL2DPlotProducer *QOpenGL2DPlot::Producer(int plot_index,
+                                               int capacity)
 {
 #ifdef QT_DEBUG
     Error error = NO_ERRORS;
     CheckPlotIndex(plot_index,plot_data->data,error);
-    CheckIndex(index,plot_data->data[plot_index],error);
     ErrorHandle(error);
 #endif
 
-    int count = points.count();
-    QPointF dummy;
+    if (!plot_data->data_producer[plot_index])
+    {
+        plot_data->data_producer[plot_index] =
+                new QOpenGL2DPlotProducer(this,capacity);
+    }
 
-    while (plot_data->data[plot_index].count() <
-           index + count)
+    return plot_data->data_producer[plot_index];
+}
+
+void QOpenGL2DPlot::scheduleUpdate()
+{
+    ScheduleUpdate(plot_data);
+}
+
+void QOpenGL2DPlot::setMaxFrameRate(double rate)
+{
+    plot_data->max_frame_rate = rate;
+}
+
+double QOpenGL2DPlot::MaxFrameRate() const
+{
+    return plot_data->max_frame_rate;
+}
+
+// Statistics of the last window frames are kept for the percentiles.
+// While disabled, stage switches and counters only test the flag.
+void QOpenGL2DPlot::setStatsEnabled(bool enable, int window)
+{
+    plot_data->stats_enabled = enable;
+    plot_data->stats_window  = std::max<int>(window,1);
+    plot_data->stats_frames  = 0;
+    plot_data->stats_stage   = NO_STAGE;
+
+    for (int i = 0; i < StageCount; i++)
     {
-        plot_data->data[plot_index].append(dummy);
+        plot_data->stats_history[i].fill(0,plot_data->stats_window);
     }
 
-    for (int i = 0; i < count; i++)
+    for (int i = 0; i < GPU_QUERIES; i++)
     {
-        plot_data->data[plot_index][index+i] = points[i];
+        plot_data->gpu_query_pending[i] = false;
     }
+
+    ClearFrameStats(plot_data->stats);
+    ClearFrameStats(plot_data->last_stats);
 }
 
-void SetPositions(PlotDataStruct *plot_data)
+bool QOpenGL2DPlot::isStatsEnabled() const
 {
-    if (plot_data->m_program.isLinked())
+    return plot_data->stats_enabled;
+}
+
+QOpenGL2DPlot::FrameStats QOpenGL2DPlot::LastFrameStats() const
+{
+    return plot_data->last_stats;
+}
+
+// Percentile from 0 to 100 of a stage time over the recorded frames, -1
+// without any frame or GPU result.
+double QOpenGL2DPlot::StagePercentile(Stage stage, double percentile) const
+{
+    int count = std::min<int>(plot_data->stats_frames,
+                              plot_data->stats_window);
+    QVector<double> times;
+
+    for (int i = 0; i < count; i++)
     {
-        plot_data->context->makeCurrent(
-                    plot_data->context->surface());
-        plot_data->m_program.bind();
+        double time = plot_data->stats_history[stage][i];
 
-        SetGridPosition(plot_data);
+        if (time >= 0)
+        {
+            times.append(time);
+        }
+    }
 
-        int count = plot_data->data.count();
+    if (times.isEmpty())
+    {
+        return -1;
+    }
 
-        for (int i = 0; i < count; i++)
+    int k = qBound<int>(0,ceil(percentile/100.0*times.count())-1,
+                        times.count()-1);
+    std::nth_element(times.begin(),times.begin()+k,times.end());
+
+    return times[k];
+}
+
+void QOpenGL2DPlot::DrainProducers()
+{
+    QVector<QPointF> points;
+
+    for (int i = 0; i < plot_data->data.count(); i++)
+    {
+        QOpenGL2DPlotProducer *producer = plot_data->data_producer[i];
+
+        if (!producer)
         {
-            SetDataPointsPosition(plot_data,i);
+            continue;
         }
 
-        plot_data->m_program.release();
-        plot_data->context->doneCurrent();
+        producer->notified.store(false,std::memory_order_release);
+
+        points.resize(producer->Pending());
+        int count = producer->pop(points.data(),points.count());
+
+        if (IsRingPlot(plot_data,i))
+        {
+            PushRingPoints(plot_data,i,points.constData(),count);
+        }
+        else
+        {
+            InsertPoints(plot_data,i,points.constData(),count,
+                         PointCount(plot_data,i));
+        }
     }
 }
 
@@ -1795,8 +4920,7 @@ void QOpenGL2DPlot::setTopRange(Axis axis, double range)
 
     plot_data->top_range[axis] = range;
 
-    SetPositions(plot_data);
-    SetScales(plot_data);
+    Invalidate(plot_data,DIRTY_RANGES);
 }
 
 void QOpenGL2DPlot::setBottomRange(Axis axis, double range)
@@ -1809,8 +4933,7 @@ void QOpenGL2DPlot::setBottomRange(Axis axis, double range)
 
     plot_data->bottom_range[axis] = range;
 
-    SetPositions(plot_data);
-    SetScales(plot_data);
+    Invalidate(plot_data,DIRTY_RANGES);
 }
 
 void QOpenGL2DPlot::setRange(Axis axis, double top,
@@ -1825,8 +4948,7 @@ void QOpenGL2DPlot::setRange(Axis axis, double top,
     plot_data->top_range[axis] = top;
     plot_data->bottom_range[axis] = bottom;
 
-    SetPositions(plot_data);
-    SetScales(plot_data);
+    Invalidate(plot_data,DIRTY_RANGES);
 }
 
 double QOpenGL2DPlot::TopRange(Axis axis) const
@@ -1850,8 +4972,7 @@ void QOpenGL2DPlot::setLogTopRange(Axis axis, double range)
 
     plot_data->log_top_range[axis] = range;
 
-    SetPositions(plot_data);
-    SetScales(plot_data);
+    Invalidate(plot_data,DIRTY_RANGES);
 }
 
 void QOpenGL2DPlot::setLogBottomRange(Axis axis, double range)
@@ -1865,8 +4986,7 @@ void QOpenGL2DPlot::setLogBottomRange(Axis axis, double range)
 
     plot_data->log_bottom_range[axis] = range;
 
-    SetPositions(plot_data);
-    SetScales(plot_data);
+    Invalidate(plot_data,DIRTY_RANGES);
 }
 
 void QOpenGL2DPlot::setLogRange(Axis axis, double top, double bottom)
@@ -1882,8 +5002,7 @@ void QOpenGL2DPlot::setLogRange(Axis axis, double top, double bottom)
     plot_data->log_top_range[axis]    = top;
     plot_data->log_bottom_range[axis] = bottom;
 
-    SetPositions(plot_data);
-    SetScales(plot_data);
+    Invalidate(plot_data,DIRTY_RANGES);
 }
 
 double QOpenGL2DPlot::LogTopRange(Axis axis) const
@@ -1904,6 +5023,33 @@ void QOpenGL2DPlot::setPlotColor(int plot_index, const QColor &color)
 #endif
 
     plot_data->data_color[plot_index] = color;
+    Invalidate(plot_data,DIRTY_NONE);
+}
+
+// Markers draw every point as a sprite of size pixels instead of
+// connecting the points, NoMarker goes back to lines.
+void QOpenGL2DPlot::setPlotMarker(int plot_index, Marker marker,
+                                  double size)
+{
+#ifdef QT_DEBUG
+    Error error = NO_ERRORS;
+    CheckPlotIndex(plot_index,plot_data->data,error);
+    ErrorHandle(error);
+#endif
+
+    plot_data->data_marker[plot_index] = marker;
+    plot_data->data_marker_size[plot_index] = std::max<double>(size,1);
+    Invalidate(plot_data,DIRTY_NONE);
+}
+
+QOpenGL2DPlot::Marker QOpenGL2DPlot::PlotMarker(int plot_index) const
+{
+    return Marker(plot_data->data_marker[plot_index]);
+}
+
+double QOpenGL2DPlot::MarkerSize(int plot_index) const
+{
+    return plot_data->data_marker_size[plot_index];
 }
 
 void QOpenGL2DPlot::showPlot(int plot_index, bool show)
@@ -1915,6 +5061,7 @@ void QOpenGL2DPlot::showPlot(int plot_index, bool show)
 #endif
 
     plot_data->data_visible[plot_index] = show;
+    Invalidate(plot_data,DIRTY_NONE);
 }
 
 void QOpenGL2DPlot::hidePlot(int plot_index, bool hide)
@@ -1926,10 +5073,7 @@ void QOpenGL2DPlot::hideLabel(Axis axis, bool hide)
 {
     plot_data->labels_visible[axis] = !hide;
 
-    if (plot_data->m_program.isLinked())
-    {
-        SetFrameSize(plot_data,rect());
-    }
+    Invalidate(plot_data,DIRTY_LAYOUT);
 }
 
 void QOpenGL2DPlot::showLabel(Axis axis, bool show)
@@ -1938,47 +5082,19 @@ void QOpenGL2DPlot::showLabel(Axis axis, bool show)
 }
 
 bool QOpenGL2DPlot::isLabelVisible(Axis axis) const
-{
-    return plot_data->labels_visible[axis];
-}
-
-bool QOpenGL2DPlot::isLabelHidden(Axis axis) const
-{
-    return !(isLabelVisible(axis));
-}
-
-void Redraw(QOpenGLWidget *parent, PlotDataStruct *plot_data)
-{
-    if (plot_data->m_program.isLinked())
-    {
-        parent->makeCurrent();
-        {
-            plot_data->m_program.bind();
-
-            int len = plot_data->data.length();
-
-            for (int i = 0; i < len; i++)
-            {
-                SetDataPointsPosition(plot_data,i);
-            }
-
-            SetFrameSize(plot_data,parent->rect());
-            SetScales(plot_data);
-            SetProjectionMatrices(plot_data,parent->rect());
-            SetPositions(plot_data);
-            SetTickLabelsPositions(plot_data);
-            SetLabels(plot_data);
+{
+    return plot_data->labels_visible[axis];
+}
 
-            plot_data->m_program.release();
-        }
-        parent->doneCurrent();
-    }
+bool QOpenGL2DPlot::isLabelHidden(Axis axis) const
+{
+    return !(isLabelVisible(axis));
 }
 
 void QOpenGL2DPlot::setTitle(const QString &title)
 {
     plot_data->title = title;
-    Redraw(this,plot_data);
+    Invalidate(plot_data,DIRTY_TEXT);
 }
 
 int axis_side(QOpenGL2DPlot::Axis axis)
@@ -2007,7 +5123,7 @@ int axis_side(QOpenGL2DPlot::Axis axis)
 void QOpenGL2DPlot::setLabel(Axis axis, const QString &label)
 {
     plot_data->labels[axis_side(axis)] = label;
-    Redraw(this,plot_data);
+    Invalidate(plot_data,DIRTY_TEXT);
 }
 
 const QString QOpenGL2DPlot::Title() const
@@ -2027,14 +5143,26 @@ int QOpenGL2DPlot::PlotCount() const
 
 int QOpenGL2DPlot::PlotSize(int index) const
 {
-    return plot_data->data[index].count();
+    return PointCount(plot_data,index);
+}
+
+QPointF QOpenGL2DPlot::Point(int plot_index, int index) const
+{
+#ifdef QT_DEBUG
+    Error error = NO_ERRORS;
+    CheckPlotIndex(plot_index,plot_data->data,error);
+    CheckIndex(index,PointCount(plot_data,plot_index),error);
+    ErrorHandle(error);
+#endif
+
+    return PointAt(plot_data,plot_index,index);
 }
 
 void QOpenGL2DPlot::setLogScale(Direction Direction,
                                 bool logscale)
 {
     plot_data->logplot[Direction] = logscale;
-    Redraw(this,plot_data);
+    Invalidate(plot_data,DIRTY_RANGES);
 }
 
 void QOpenGL2DPlot::setLinearScale(Direction Direction,
@@ -2061,7 +5189,7 @@ void QOpenGL2DPlot::hideTickLabel(Axis axis, bool hide)
 void QOpenGL2DPlot::showTitle(bool show)
 {
     plot_data->title_visible = show;
-    Redraw(this,plot_data);
+    Invalidate(plot_data,DIRTY_LAYOUT);
 }
 
 void QOpenGL2DPlot::hideTitle(bool hide)
@@ -2077,7 +5205,7 @@ bool QOpenGL2DPlot::isTitleVisible() const
 void QOpenGL2DPlot::showTickLabel(Axis axis, bool show)
 {
     plot_data->tick_labels_visible[axis] = show;
-    Redraw(this,plot_data);
+    Invalidate(plot_data,DIRTY_LAYOUT);
 }
 
 bool QOpenGL2DPlot::isTickLabelVisible(Axis axis) const
@@ -2093,11 +5221,7 @@ void QOpenGL2DPlot::setTickStep(Axis axis, double step)
 {
     plot_data->tick_step[axis] = step;
 
-    uint count = floor((plot_data->top_range-
-                  plot_data->bottom_range)/step);
-    plot_data->ticks_count[axis] = count;
-
-    Redraw(this,plot_data);
+    Invalidate(plot_data,DIRTY_GRID | DIRTY_TICKS | DIRTY_LABELS);
 }
 
 void QOpenGL2DPlot::setTicks(Axis axis, uint amount)
@@ -2113,7 +5237,7 @@ void QOpenGL2DPlot::setSecTicks(Axis axis, uint amount)
 {
     plot_data->sec_ticks_count[axis] = amount;
 
-    Redraw(this,plot_data);
+    Invalidate(plot_data,DIRTY_GRID);
 }
 
 double QOpenGL2DPlot::TickStep(Axis axis) const
@@ -2136,6 +5260,7 @@ uint QOpenGL2DPlot::SecTicks(Axis axis) const
 void QOpenGL2DPlot::showGridLines(Axis axis, bool show)
 {
     plot_data->grid_visible[axis] = show;
+    Invalidate(plot_data,DIRTY_DECORATIONS);
 }
 
 void QOpenGL2DPlot::hideGridLines(Axis axis, bool hide)
@@ -2146,6 +5271,7 @@ void QOpenGL2DPlot::hideGridLines(Axis axis, bool hide)
 void QOpenGL2DPlot::showTicks(Axis axis, bool show)
 {
     plot_data->ticks_visible[axis] = show;
+    Invalidate(plot_data,DIRTY_DECORATIONS);
 }
 
 void QOpenGL2DPlot::hideTicks(Axis axis, bool hide)
@@ -2156,6 +5282,7 @@ void QOpenGL2DPlot::hideTicks(Axis axis, bool hide)
 void QOpenGL2DPlot::showSecGridLines(Axis axis, bool show)
 {
     plot_data->sec_grid_visible[axis] = show;
+    Invalidate(plot_data,DIRTY_DECORATIONS);
 }
 
 void QOpenGL2DPlot::hideSecGridLines(Axis axis, bool hide)
@@ -2166,6 +5293,7 @@ void QOpenGL2DPlot::hideSecGridLines(Axis axis, bool hide)
 void QOpenGL2DPlot::showSecTicks(Axis axis, bool show)
 {
     plot_data->sec_ticks_visible[axis] = show;
+    Invalidate(plot_data,DIRTY_DECORATIONS);
 }
 
 void QOpenGL2DPlot::hideSecTicks(Axis axis, bool hide)
@@ -2187,6 +5315,7 @@ void QOpenGL2DPlot::setGridColor(Axis axis,
                                  const QColor &color)
 {
     plot_data->grid_color[axis] = color;
+    Invalidate(plot_data,DIRTY_DECORATIONS);
 }
 
 void QOpenGL2DPlot::setGridColor(const QColor &color)
@@ -2206,6 +5335,7 @@ void QOpenGL2DPlot::setSecGridColor(Axis axis,
                                     const QColor &color)
 {
     plot_data->sec_grid_color[axis] = color;
+    Invalidate(plot_data,DIRTY_DECORATIONS);
 }
 
 void QOpenGL2DPlot::setSecGridColor(const QColor &color)
@@ -2221,94 +5351,564 @@ QColor QOpenGL2DPlot::SecGridColor(Axis axis) const
     return plot_data->sec_grid_color[axis];
 }
 
-void DrawDataPainter(PlotDataStruct *plot_data)
+// Fraction of the pane a value of the axis of side is at, counted from
+// the bottom or left edge. Values a logarithmic axis cannot show end up
+// below the pane.
+double PaneFraction(PlotDataStruct *plot_data, int side, double value)
 {
-    QPainter *painter = &(plot_data->painter);
+    bool logplot = plot_data->logplot[IsVerticalSide(side) ? VERTICAL :
+                                                             HORIZONTAL];
 
-    painter->resetTransform();
+    if (logplot)
+    {
+        double bot = log10(plot_data->log_bottom_range[side]);
+        double top = log10(plot_data->log_top_range[side]);
+
+        return value > 0 ? (log10(value)-bot)/(top-bot) : -1;
+    }
+
+    return (value-plot_data->bottom_range[side])/
+            (plot_data->top_range[side]-plot_data->bottom_range[side]);
+}
+
+// Pane fractions of a data point on the bottom and left axes
+QPointF PaneFractions(PlotDataStruct *plot_data, const QPointF &point)
+{
+    return QPointF(PaneFraction(plot_data,BOTTOM,point.x()),
+                   PaneFraction(plot_data,LEFT,point.y()));
+}
+
+// Device coordinates of pane fractions
+QPointF PainterPoint(PlotDataStruct *plot_data, const QPointF &fraction)
+{
+    QRectF pane = plot_data->plot_pane;
+
+    return QPointF(pane.x()+fraction.x()*pane.width(),
+                   pane.y()+(1-fraction.y())*pane.height());
+}
+
+// Liang-Barsky clip of the segment a-b, in pane fractions, to the box of
+// EXPORT_PANE_LIMIT around the pane, so far away points do not blow up
+// the output while every segment keeps its slope. Returns false when
+// nothing of the segment is left.
+bool ClipPainterSegment(QPointF &a, QPointF &b)
+{
+    double dx = b.x()-a.x();
+    double dy = b.y()-a.y();
+    double p[4] = {-dx, dx, -dy, dy};
+    double q[4] = {a.x()+EXPORT_PANE_LIMIT, EXPORT_PANE_LIMIT-a.x(),
+                   a.y()+EXPORT_PANE_LIMIT, EXPORT_PANE_LIMIT-a.y()};
+    double t0 = 0;
+    double t1 = 1;
+
+    for (int k = 0; k < 4; k++)
+    {
+        if (p[k] == 0)
+        {
+            if (q[k] < 0)
+            {
+                return false;
+            }
+
+            continue;
+        }
+
+        double t = q[k]/p[k];
+
+        if (p[k] < 0)
+        {
+            t0 = std::max<double>(t0,t);
+        }
+        else
+        {
+            t1 = std::min<double>(t1,t);
+        }
+
+        if (t0 > t1)
+        {
+            return false;
+        }
+    }
+
+    QPointF start = a;
+
+    if (t1 < 1)
+    {
+        b = QPointF(start.x()+t1*dx,start.y()+t1*dy);
+    }
+
+    if (t0 > 0)
+    {
+        a = QPointF(start.x()+t0*dx,start.y()+t0*dy);
+    }
+
+    return qIsFinite(a.x()) && qIsFinite(a.y()) &&
+            qIsFinite(b.x()) && qIsFinite(b.y());
+}
+
+// Pixel column of a polyline being decimated, vertices are numbered in
+// the order they are added.
+struct PainterBucketStruct {
+    int index[4];
+    QPointF point[4];
+    int column;
+    int count;
+    bool pending;
+};
+
+void FlushPainterBucket(PainterBucketStruct &bucket, QPolygonF &points)
+{
+    int *index = bucket.index;
+    QPointF *point = bucket.point;
+
+    if (bucket.pending && index[1] > index[2])
+    {
+        std::swap(index[1],index[2]);
+        std::swap(point[1],point[2]);
+    }
+
+    int last = -1;
+
+    for (int k = 0; bucket.pending && k < 4; k++)
+    {
+        if (index[k] != last)
+        {
+            points.append(point[k]);
+            last = index[k];
+        }
+    }
+
+    bucket.pending = false;
+}
+
+// Keeps the first, lowest, highest and last vertex of each run of
+// vertices in the same pixel column, in order.
+void AddPainterVertex(PainterBucketStruct &bucket, const QPointF &p,
+                      QPolygonF &points)
+{
+    int j = bucket.count++;
+    int c = floor(p.x());
+
+    if (bucket.pending && c != bucket.column)
+    {
+        FlushPainterBucket(bucket,points);
+    }
+
+    if (!bucket.pending)
+    {
+        std::fill(bucket.index,bucket.index+4,j);
+        std::fill(bucket.point,bucket.point+4,p);
+        bucket.column  = c;
+        bucket.pending = true;
+        return;
+    }
+
+    if (p.y() < bucket.point[1].y())
+    {
+        bucket.index[1] = j;
+        bucket.point[1] = p;
+    }
+
+    if (p.y() > bucket.point[2].y())
+    {
+        bucket.index[2] = j;
+        bucket.point[2] = p;
+    }
+
+    bucket.index[3] = j;
+    bucket.point[3] = p;
+}
+
+void EndPainterRun(PainterBucketStruct &bucket, QPolygonF &points,
+                   QPainterPath &path)
+{
+    FlushPainterBucket(bucket,points);
+
+    if (points.count() > 1)
+    {
+        path.addPolygon(points);
+    }
+
+    points.resize(0);
+}
+
+// Adds the clipped segments of a plot to path, one subpath per run that
+// stays within the clip box, each decimated to at most four vertices per
+// pixel column of the output. The line covers the same pixels as the
+// full one, spikes included.
+void DecimatePainterLine(PlotDataStruct *plot_data, int plot_index,
+                         int from, int to, QPainterPath &path)
+{
+    PainterBucketStruct bucket;
+    bucket.count   = 0;
+    bucket.pending = false;
+
+    QPolygonF points;
+    QPointF previous;
+    QPointF last;
+    bool started = false;
+    bool open = false;
+
+    for (int j = from; j < to; j++)
+    {
+        QPointF p = PaneFractions(plot_data,
+                                  PointAt(plot_data,plot_index,j));
+
+        if (!qIsFinite(p.x()) || !qIsFinite(p.y()))
+        {
+            continue;
+        }
+
+        QPointF a = previous;
+        QPointF b = p;
+
+        previous = p;
+
+        if (!started)
+        {
+            started = true;
+            continue;
+        }
+
+        if (!ClipPainterSegment(a,b))
+        {
+            EndPainterRun(bucket,points,path);
+            open = false;
+            continue;
+        }
+
+        if (!open || a != last)
+        {
+            EndPainterRun(bucket,points,path);
+            AddPainterVertex(bucket,PainterPoint(plot_data,a),points);
+        }
+
+        AddPainterVertex(bucket,PainterPoint(plot_data,b),points);
+
+        last = b;
+        open = true;
+    }
+
+    EndPainterRun(bucket,points,path);
+}
+
+// Keeps one marker per pixel of the pane, markers outside it are
+// dropped like the scissored ones on screen.
+void DecimatePainterMarkers(PlotDataStruct *plot_data, int plot_index,
+                            int from, int to, QPolygonF &points)
+{
+    QRect pane = plot_data->plot_pane;
+    QVector<bool> used(pane.width()*pane.height(),false);
+
+    for (int j = from; j < to; j++)
     {
-        QMatrix4x4 mat;
-        mat.setToIdentity();
+        QPointF f = PaneFractions(plot_data,
+                                  PointAt(plot_data,plot_index,j));
+
+        if (!(f.x() >= 0 && f.x() <= 1 && f.y() >= 0 && f.y() <= 1))
+        {
+            continue;
+        }
+
+        QPointF p = PainterPoint(plot_data,f);
+
+        int x = floor(p.x())-pane.x();
+        int y = floor(p.y())-pane.y();
+
+        if (x < 0 || y < 0 || x >= pane.width() || y >= pane.height() ||
+            used[y*pane.width()+x])
+        {
+            continue;
+        }
+
+        used[y*pane.width()+x] = true;
+        points.append(p);
+    }
+}
 
-        int count1 = plot_data->data.count();
-        int count2;
+// Same shapes as the point sprites of the fragment shader
+void AddMarker(QPainterPath &path, int marker, const QPointF &p,
+               double size)
+{
+    double r = size/2;
 
-        double top_x = plot_data->top_range[BOTTOM];
-        double top_y = plot_data->top_range[LEFT];
+    switch (marker)
+    {
+    case QOpenGL2DPlot::Circle:
+        path.addEllipse(p,r,r);
+        break;
+    case QOpenGL2DPlot::Square:
+        path.addRect(QRectF(p.x()-r,p.y()-r,size,size));
+        break;
+    case QOpenGL2DPlot::Cross:
+        path.addRect(QRectF(p.x()-r,p.y()-0.2*r,size,0.4*r));
+        path.addRect(QRectF(p.x()-0.2*r,p.y()-r,0.4*r,size));
+        break;
+    case QOpenGL2DPlot::Triangle:
+        path.moveTo(p.x(),p.y()-r);
+        path.lineTo(p.x()+r,p.y()+r);
+        path.lineTo(p.x()-r,p.y()+r);
+        path.closeSubpath();
+        break;
+    }
+}
 
-        double bot_x = plot_data->bottom_range[BOTTOM];
-        double bot_y = plot_data->bottom_range[LEFT];
+// Each plot is one path, decimated to the output resolution, so the size
+// of an export follows its pixel size rather than the point count.
+void DrawDataPainter(PlotDataStruct *plot_data)
+{
+    QPainter *painter = &(plot_data->painter);
 
-        double delta_x = top_x-bot_x;
-        double delta_y = top_y-bot_y;
+    painter->save();
+    painter->setClipRect(plot_data->plot_pane);
 
-        double x_offset = (bot_x/delta_x)*plot_data->plot_pane.width();
-        double y_offset = (bot_y/delta_y)*plot_data->plot_pane.height();
-        y_offset += plot_data->plot_pane.height();
+    for (int i = 0; i < plot_data->data.count(); i++)
+    {
+        if (!plot_data->data_visible[i])
+        {
+            continue;
+        }
 
-        QRect viewport = plot_data->plot_pane;
-        viewport.translate(-x_offset,y_offset);
+        int count = PointCount(plot_data,i);
+        int from = 0;
+        int to = count;
 
-        painter->setViewport(viewport);
+        if (plot_data->data_sorted[i])
+        {
+            VisibleDataRange(plot_data,i,from,to);
+            PadVisibleRange(count,from,to);
+        }
 
-        double x_scale = viewport.width()/delta_x;
-        double y_scale = viewport.height()/delta_y;
-        mat.scale(x_scale,-y_scale);
+        int marker = plot_data->data_marker[i];
+        QPolygonF points;
+        QPainterPath path;
 
-        for (int i = 0; i < count1; i++)
+        if (marker != QOpenGL2DPlot::NoMarker)
         {
-            painter->setPen(plot_data->data_color.at(i));
+            DecimatePainterMarkers(plot_data,i,from,to,points);
 
-            count2 = plot_data->data[i].count();
-            count2--;
-            QPointF *pts = plot_data->data[i].data();
-            QPointF pt1,pt2;
+            path.setFillRule(Qt::WindingFill);
 
-            for (int j = 0; j < count2; j++)
+            for (const QPointF &p : points)
             {
-                pt1 = pts[j]*mat;
-                pt2 = pts[j+1]*mat;
+                AddMarker(path,marker,p,plot_data->data_marker_size[i]);
+            }
+
+            painter->setPen(Qt::NoPen);
+            painter->setBrush(plot_data->data_color[i]);
+        }
+        else
+        {
+            DecimatePainterLine(plot_data,i,from,to,path);
 
-                painter->drawLine(pt1,pt2);
+            if (path.isEmpty())
+            {
+                continue;
             }
+
+            painter->setPen(plot_data->data_color[i]);
+            painter->setBrush(Qt::NoBrush);
         }
+
+        painter->drawPath(path);
     }
-    painter->resetTransform();
+
+    painter->restore();
 }
 
 void DrawFramePainter(PlotDataStruct *plot_data)
 {
     QPainter *painter = &(plot_data->painter);
 
+    if (!plot_data->frame_visible)
+    {
+        return;
+    }
+
     painter->resetTransform();
     {
         painter->setPen(plot_data->frame_color);
+        painter->setBrush(Qt::NoBrush);
         painter->drawRect(plot_data->plot_pane);
     }
     painter->resetTransform();
 }
 
+// Lines across the pane at the given steps of a side, or ticks of the
+// given length into the pane from that side.
+void AddGridLines(PlotDataStruct *plot_data, int side,
+                  const QVector<double> &steps, double length,
+                  QPainterPath &path)
+{
+    QRectF pane = plot_data->plot_pane;
+
+    for (double step : steps)
+    {
+        if (step < 0 || step > 1)
+        {
+            continue;
+        }
+
+        if (IsVerticalSide(side))
+        {
+            double y = pane.y()+(1-step)*pane.height();
+            double x = side == LEFT ? pane.left() : pane.right();
+            double l = length > 0 ? length : pane.width();
+
+            path.moveTo(x,y);
+            path.lineTo(side == LEFT ? x+l : x-l,y);
+        }
+        else
+        {
+            double x = pane.x()+step*pane.width();
+            double y = side == BOTTOM ? pane.bottom() : pane.top();
+            double l = length > 0 ? length : pane.height();
+
+            path.moveTo(x,y);
+            path.lineTo(x,side == BOTTOM ? y-l : y+l);
+        }
+    }
+}
+
 void DrawGridPainter(PlotDataStruct *plot_data)
 {
+    QPainter *painter = &(plot_data->painter);
+    QVector<double> major;
+    QVector<double> minor;
+
+    painter->save();
+    painter->setClipRect(plot_data->plot_pane);
+    painter->setBrush(Qt::NoBrush);
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (plot_data->sec_grid_visible[i])
+        {
+            QPainterPath path;
+
+            GridSteps(plot_data,i,major,minor);
+            AddGridLines(plot_data,i,minor,0,path);
+
+            painter->setPen(plot_data->sec_grid_color[i]);
+            painter->drawPath(path);
+        }
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (plot_data->grid_visible[i])
+        {
+            QPainterPath path;
+
+            GridSteps(plot_data,i,major,minor);
+            AddGridLines(plot_data,i,major,0,path);
+
+            painter->setPen(plot_data->grid_color[i]);
+            painter->drawPath(path);
+        }
+    }
+
+    painter->restore();
+}
+
+void DrawTicksPainter(PlotDataStruct *plot_data)
+{
+    QPainter *painter = &(plot_data->painter);
+    QVector<double> major;
+    QVector<double> minor;
+    QPainterPath path;
+
+    for (int i = 0; i < 4; i++)
+    {
+        GridSteps(plot_data,i,major,minor);
+
+        if (plot_data->ticks_visible[i])
+        {
+            AddGridLines(plot_data,i,major,EXPORT_TICK_LENGTH,path);
+        }
+
+        if (plot_data->sec_ticks_visible[i])
+        {
+            AddGridLines(plot_data,i,minor,EXPORT_SEC_TICK_LENGTH,path);
+        }
+    }
+
+    painter->save();
+    painter->setClipRect(plot_data->plot_pane);
+    painter->setPen(plot_data->frame_color);
+    painter->setBrush(Qt::NoBrush);
+    painter->drawPath(path);
+    painter->restore();
 }
 
-void QOpenGL2DPlot::SaveSVG(const QString &fileName,
-                            const QString &description)
+// The part of ValidateState() that painting needs, so an export follows
+// the current ranges and text without waiting for a frame. The dirty
+// flags stay set for the next frame, which still has to upload its part.
+void ValidatePainterState(PlotDataStruct *plot_data, const QRect &rect)
 {
-    QSvgGenerator generator;
-    generator.setFileName(fileName);
-    generator.setDescription(description);
-    generator.setSize(this->size());
-    generator.setViewBox(this->rect());
+    uint dirty = plot_data->dirty;
+
+    SetFrameLayout(plot_data,rect);
+    SetTickLabelsPositions(plot_data);
+    SetLabels(plot_data);
 
+    plot_data->dirty = dirty;
+}
+
+// Lays the plot out in rect and paints it
+void DrawPainter(PlotDataStruct *plot_data, QPaintDevice *device,
+                 const QRect &rect)
+{
     QPainter *painter = &(plot_data->painter);
-    painter->begin(&generator);
+
+    ValidatePainterState(plot_data,rect);
+
+    painter->begin(device);
     {
+        DrawGridPainter(plot_data);
         DrawDataPainter(plot_data);
         DrawFramePainter(plot_data);
+        DrawTicksPainter(plot_data);
 
         DrawTitle(plot_data);
         DrawLabels(plot_data);
     }
     painter->end();
 }
+
+QRect ExportRect(PlotDataStruct *plot_data, const QRect &widget_rect)
+{
+    return plot_data->viewport.isEmpty() ? widget_rect :
+                                           plot_data->viewport;
+}
+
+void QOpenGL2DPlot::SaveSVG(const QString &fileName,
+                            const QString &description)
+{
+    QRect rect = ExportRect(plot_data,this->rect());
+
+    QSvgGenerator generator;
+    generator.setFileName(fileName);
+    generator.setDescription(description);
+    generator.setSize(rect.size());
+    generator.setViewBox(rect);
+
+    DrawPainter(plot_data,&generator,rect);
+}
+
+// One page of the plot's pixel size, at 72 dpi a pixel is a point
+void QOpenGL2DPlot::SavePDF(const QString &fileName,
+                            const QString &description)
+{
+    QRect rect = ExportRect(plot_data,this->rect());
+
+    QPdfWriter writer(fileName);
+    writer.setTitle(description);
+    writer.setResolution(72);
+    writer.setPageLayout(QPageLayout(
+                             QPageSize(rect.size(),QPageSize::Point,
+                                       QString(),QPageSize::ExactMatch),
+                             QPageLayout::Portrait,QMarginsF()));
+
+    DrawPainter(plot_data,&writer,rect);
+}
@@ -18,12 +18,28 @@
 #include <QOpenGLShaderProgram>
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLPaintDevice>
+#include <QOpenGLTexture>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLTimerQuery>
 #include <QPointF>
+#include <QHash>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QScreen>
 
 #include <QFile>
 #include <QtSvg/QSvgGenerator>
+#include <QPdfWriter>
+#include <QPainterPath>
+#include <QPolygonF>
 
 #include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <numeric>
+
+#include "QOpenGL2DPlotProducer.h"
 
 #ifdef QT_DEBUG
 #include <QDebug>
@@ -32,6 +48,9 @@
 
 typedef struct PlotDataStruct PlotDataStruct;
 
+class QOpenGL2DPlotCapture;
+class QOpenGL2DPlotRenderer;
+
 class QOpenGL2DPlot : public QOpenGLWidget, protected QOpenGLFunctions
 {
     Q_OBJECT
@@ -48,6 +67,44 @@ public:
         Horizontal = 1
     };
 
+    enum SampleType {
+        Int16   = 0,
+        Int32   = 1,
+        Float   = 2,
+        Double  = 3
+    };
+
+    enum Marker {
+        NoMarker = 0,
+        Circle   = 1,
+        Square   = 2,
+        Cross    = 3,
+        Triangle = 4
+    };
+
+    enum Stage {
+        LayoutStage   = 0,
+        GeometryStage = 1,
+        UploadStage   = 2,
+        TextStage     = 3,
+        GridStage     = 4,
+        DataStage     = 5,
+        FrameStage    = 6,
+        TotalStage    = 7,
+        GpuStage      = 8,
+        StageCount    = 9
+    };
+
+    // Times are in seconds, the GPU time is -1 until a timer query
+    // result is available.
+    struct FrameStats {
+        double time[StageCount];
+        qint64 vertices;
+        qint64 draw_calls;
+        qint64 bytes_uploaded;
+        qint64 points_ingested;
+    };
+
 private:
     PlotDataStruct *plot_data;
 
@@ -69,6 +126,7 @@ public:
 
     int PlotCount() const;
     int PlotSize(int index) const;
+    QPointF Point(int plot_index, int index) const;
 
     void hideLabel(Axis axis, bool hide = true);
     void showLabel(Axis axis, bool show = true);
@@ -90,15 +148,64 @@ public:
 
     void addPlot(int before = 0);
     void addPlots(int count, int before = 0);
-    void addPlots(const QVector<QVector<QPointF>> data, int before = 0);
+    void addPlots(const QVector<QVector<QPointF>> &data, int before = 0);
+    void addPlots(QVector<QVector<QPointF>> &&data, int before = 0);
 
     void addPoint(int plot_index, const QPointF &point, int pos = 0);
     void addPoints(int plot_index, const QVector<QPointF> &points, int pos = 0);
+    void addPoints(int plot_index, QVector<QPointF> &&points, int pos = 0);
+
+    void appendPoint(int plot_index, const QPointF &point);
+    void appendPoints(int plot_index, const QVector<QPointF> &points);
+    void appendPoints(int plot_index, QVector<QPointF> &&points);
 
     void setPoint(int plot_index, const QPointF &point, int index);
     void setPoints(int plot_index, const QVector<QPointF> &points, int index);
     void setPoints(int plot_index, const QPointF point, int from, int to);
 
+    void setPlotCapacity(int plot_index, int capacity);
+    int PlotCapacity(int plot_index) const;
+
+    void setSamples(int plot_index, const void *y, SampleType type,
+                    int count, double x0 = 0, double dt = 1);
+    void setSamples(int plot_index, const void *x, SampleType x_type,
+                    const void *y, SampleType y_type, int count);
+
+    void appendSamples(int plot_index, const void *y, int count);
+    void appendSamples(int plot_index, const void *x, const void *y,
+                       int count);
+
+    void setSampleSpacing(int plot_index, double x0, double dt);
+
+    SampleType PlotSampleType(int plot_index) const;
+    bool hasImplicitX(int plot_index) const;
+
+    void setSampleView(int plot_index, const void *y, SampleType type,
+                       int count, int stride = 0,
+                       double x0 = 0, double dt = 1);
+    void setSampleView(int plot_index,
+                       const void *x, SampleType x_type, int x_stride,
+                       const void *y, SampleType y_type, int y_stride,
+                       int count);
+    void updateSamples(int plot_index, int from = 0, int to = -1,
+                       int count = -1);
+
+    bool isSampleView(int plot_index) const;
+
+    void setCapture(int plot_index, QOpenGL2DPlotCapture *capture,
+                    int column = 0);
+
+    QOpenGL2DPlotProducer *Producer(int plot_index, int capacity = 65536);
+
+    void setMaxFrameRate(double rate);
+    double MaxFrameRate() const;
+
+    void setStatsEnabled(bool enable = true, int window = 256);
+    bool isStatsEnabled() const;
+
+    FrameStats LastFrameStats() const;
+    double StagePercentile(Stage stage, double percentile) const;
+
     void clearPoints(int plot_index, int from, int to);                                     //TODO
     void clearPoints(int plot_index);                                                       //TODO
 
@@ -154,6 +261,10 @@ public:
 
     void setPlotColor(int plot_index, const QColor &color);
 
+    void setPlotMarker(int plot_index, Marker marker, double size = 5);
+    Marker PlotMarker(int plot_index) const;
+    double MarkerSize(int plot_index) const;
+
     void showPlot(int plot_index, bool show = true);
     void hidePlot(int plot_index, bool hide = true);
 
@@ -161,6 +272,22 @@ public:
 
     void SaveSVG(const QString &fileName,
                  const QString &description = QString(""));
+    void SavePDF(const QString &fileName,
+                 const QString &description = QString(""));
+
+signals:
+    void frameStats(const QOpenGL2DPlot::FrameStats &stats);
+
+private:
+    void DrainProducers();
+    void PaintFrame(const QRect &rect, const QSize &pixels, GLuint target);
+    bool RenderOffscreen(const QSize &size, GLuint target);
+    void ReleaseGL();
+
+    friend class QOpenGL2DPlotRenderer;
+
+private slots:
+    void scheduleUpdate();
 
 protected:
     void initializeGL();
@@ -168,4 +295,8 @@ protected:
     void resizeGL(int w, int h);
 };
 
+// Bytes per stored sample of a type, shared with the capture files and
+// the acquisition decoder.
+int SampleSize(QOpenGL2DPlot::SampleType type);
+
 #endif // QOPENGL2DPLOT_H
@@ -7,6 +7,7 @@
 QT       += core gui
 QT       += opengl
 QT       += svg
+QT       += concurrent
 QT       += serialport
 
 CONFIG += c++14
@@ -18,8 +19,26 @@ TEMPLATE = app
 
 SOURCES += main.cpp\
         mainwindow.cpp \
-    QOpenGL2DPlot.cpp
+    QOpenGL2DPlot.cpp \
+    QOpenGL2DPlotProducer.cpp \
+    QOpenGL2DPlotCapture.cpp \
+    QOpenGL2DPlotAcquisition.cpp \
+    QOpenGL2DPlotCsv.cpp \
+    QOpenGL2DPlotRenderer.cpp
+
+# The AVX2 scanner of the CSV parser is built on its own with AVX2
+# enabled and only used when the CPU has it
+contains(QT_ARCH, x86_64)|contains(QT_ARCH, i386) {
+    CONFIG += simd
+    AVX2_SOURCES += QOpenGL2DPlotCsvAvx2.cpp
+    DEFINES += QOPENGL2DPLOT_CSV_AVX2
+}
 
 HEADERS  += mainwindow.h \
-    QOpenGL2DPlot.h
+    QOpenGL2DPlot.h \
+    QOpenGL2DPlotProducer.h \
+    QOpenGL2DPlotCapture.h \
+    QOpenGL2DPlotAcquisition.h \
+    QOpenGL2DPlotCsv.h \
+    QOpenGL2DPlotRenderer.h
 
@@ -0,0 +1,420 @@
+#include "QOpenGL2DPlotAcquisition.h"
+#include "QOpenGL2DPlotCsv.h"
+
+#include <QtEndian>
+#include <QtSerialPort/QSerialPort>
+
+#include <string.h>
+
+#define ACQUISITION_QUEUE_SIZE      (1 << 20)
+#define ACQUISITION_MAX_LINE        65536
+
+int FrameChecksumSize(QOpenGL2DPlotAcquisition::Checksum checksum)
+{
+    switch (checksum)
+    {
+    case QOpenGL2DPlotAcquisition::Sum8:
+    case QOpenGL2DPlotAcquisition::Xor8:
+        return 1;
+    case QOpenGL2DPlotAcquisition::Crc16:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+template <typename T>
+T FrameInteger(const char *src, bool big_endian)
+{
+    const uchar *bytes = reinterpret_cast<const uchar*>(src);
+
+    return big_endian ? qFromBigEndian<T>(bytes) :
+                        qFromLittleEndian<T>(bytes);
+}
+
+double FrameSample(const char *src, QOpenGL2DPlot::SampleType type,
+                   bool big_endian)
+{
+    switch (type)
+    {
+    case QOpenGL2DPlot::Int16:
+        return qint16(FrameInteger<quint16>(src,big_endian));
+    case QOpenGL2DPlot::Int32:
+        return qint32(FrameInteger<quint32>(src,big_endian));
+    case QOpenGL2DPlot::Float:
+    {
+        quint32 bits = FrameInteger<quint32>(src,big_endian);
+        float value;
+        memcpy(&value,&bits,sizeof(value));
+        return value;
+    }
+    default:
+    {
+        quint64 bits = FrameInteger<quint64>(src,big_endian);
+        double value;
+        memcpy(&value,&bits,sizeof(value));
+        return value;
+    }
+    }
+}
+
+// CRC-16/CCITT-FALSE, polynomial 0x1021 and initial value 0xFFFF
+quint16 FrameCrc16(const uchar *data, int size)
+{
+    quint16 crc = 0xFFFF;
+
+    for (int i = 0; i < size; i++)
+    {
+        crc ^= quint16(data[i]) << 8;
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+bool FrameChecksumMatches(QOpenGL2DPlotAcquisition::Checksum checksum,
+                          const char *payload, int size,
+                          const char *check, bool big_endian)
+{
+    const uchar *data = reinterpret_cast<const uchar*>(payload);
+    uchar value = 0;
+
+    switch (checksum)
+    {
+    case QOpenGL2DPlotAcquisition::Sum8:
+        for (int i = 0; i < size; i++)
+        {
+            value += data[i];
+        }
+        return value == uchar(check[0]);
+    case QOpenGL2DPlotAcquisition::Xor8:
+        for (int i = 0; i < size; i++)
+        {
+            value ^= data[i];
+        }
+        return value == uchar(check[0]);
+    case QOpenGL2DPlotAcquisition::Crc16:
+        return FrameCrc16(data,size) ==
+                FrameInteger<quint16>(check,big_endian);
+    default:
+        return true;
+    }
+}
+
+QOpenGL2DPlotAcquisition::QOpenGL2DPlotAcquisition(QOpenGL2DPlot *plot,
+                                                   QObject *parent):
+    QObject(parent),
+    plot(plot),
+    thread(nullptr),
+    device(nullptr),
+    framing(Binary),
+    type(QOpenGL2DPlot::Int16),
+    checksum(NoChecksum),
+    big_endian(false),
+    separator(','),
+    terminator('\n'),
+    x_column(false),
+    x0(0),
+    dt(1),
+    sample(0),
+    frames(0),
+    errors(0),
+    bytes(0)
+{
+}
+
+QOpenGL2DPlotAcquisition::~QOpenGL2DPlotAcquisition()
+{
+    stop();
+}
+
+void QOpenGL2DPlotAcquisition::setChannels(const QVector<int> &plots)
+{
+    this->plots = plots;
+}
+
+void QOpenGL2DPlotAcquisition::setSampleSpacing(double x0, double dt)
+{
+    this->x0 = x0;
+    this->dt = dt;
+}
+
+void QOpenGL2DPlotAcquisition::setBinaryFraming(
+        const QByteArray &sync, QOpenGL2DPlot::SampleType type,
+        Checksum checksum, bool big_endian)
+{
+    this->framing    = Binary;
+    this->sync       = sync;
+    this->type       = type;
+    this->checksum   = checksum;
+    this->big_endian = big_endian;
+}
+
+void QOpenGL2DPlotAcquisition::setAsciiFraming(char separator,
+                                               char terminator,
+                                               bool x_column)
+{
+    this->framing    = Ascii;
+    this->separator  = separator;
+    this->terminator = terminator;
+    this->x_column   = x_column;
+}
+
+// The port is only configured here, it is opened by the worker thread
+// that owns it.
+bool QOpenGL2DPlotAcquisition::start(const QString &portName,
+                                     qint32 baudRate)
+{
+    QSerialPort *port = new QSerialPort;
+
+    port->setPortName(portName);
+    port->setBaudRate(baudRate);
+    port->setReadBufferSize(0);
+
+    return start(port);
+}
+
+// Takes ownership of the device, which must not have a parent. It is
+// moved to the worker thread and opened there if it is not open yet.
+bool QOpenGL2DPlotAcquisition::start(QIODevice *device)
+{
+    stop();
+
+    if (plots.isEmpty())
+    {
+        delete device;
+        return false;
+    }
+
+    producers.clear();
+
+    for (int plot_index : plots)
+    {
+        producers.append(plot->Producer(plot_index,ACQUISITION_QUEUE_SIZE));
+    }
+
+    batch.fill(QVector<QPointF>(),plots.count());
+    pending.clear();
+    sample = 0;
+
+    this->device = device;
+    thread = new QThread;
+    device->moveToThread(thread);
+
+    // A device that does not open ends the worker, isRunning() turns
+    // false once its thread has finished
+    connect(thread,&QThread::started,device,[this]()
+    {
+        if (!this->device->isOpen() &&
+            !this->device->open(QIODevice::ReadOnly))
+        {
+            this->thread->quit();
+            emit error(this->device->errorString());
+            return;
+        }
+
+        ReadDevice();
+    });
+    connect(device,&QIODevice::readyRead,device,[this]()
+    {
+        ReadDevice();
+    });
+    connect(thread,&QThread::finished,device,&QObject::deleteLater);
+
+    thread->start();
+
+    return true;
+}
+
+// Deferred deletes of the worker are run as the thread finishes, so the
+// device is closed and gone once this returns.
+void QOpenGL2DPlotAcquisition::stop()
+{
+    if (!thread)
+    {
+        return;
+    }
+
+    thread->quit();
+    thread->wait();
+
+    delete thread;
+    thread = nullptr;
+    device = nullptr;
+}
+
+bool QOpenGL2DPlotAcquisition::isRunning() const
+{
+    return thread && thread->isRunning();
+}
+
+quint64 QOpenGL2DPlotAcquisition::Frames() const
+{
+    return frames.load(std::memory_order_relaxed);
+}
+
+quint64 QOpenGL2DPlotAcquisition::Errors() const
+{
+    return errors.load(std::memory_order_relaxed);
+}
+
+quint64 QOpenGL2DPlotAcquisition::Bytes() const
+{
+    return bytes.load(std::memory_order_relaxed);
+}
+
+quint64 QOpenGL2DPlotAcquisition::Dropped() const
+{
+    quint64 dropped = 0;
+
+    for (QOpenGL2DPlotProducer *producer : producers)
+    {
+        dropped += producer->Dropped();
+    }
+
+    return dropped;
+}
+
+// Everything available is decoded at once, only an incomplete frame is
+// kept for the next read.
+void QOpenGL2DPlotAcquisition::ReadDevice()
+{
+    QByteArray data = device->readAll();
+
+    if (data.isEmpty())
+    {
+        return;
+    }
+
+    bytes.fetch_add(data.size(),std::memory_order_relaxed);
+    pending.append(data);
+
+    int used = framing == Binary ?
+                DecodeBinary(pending.constData(),pending.size()) :
+                DecodeAscii(pending.constData(),pending.size());
+
+    pending.remove(0,used);
+
+    Flush();
+}
+
+// Frames that do not start with the sync bytes or fail the checksum are
+// skipped one byte at a time until the stream locks again.
+int QOpenGL2DPlotAcquisition::DecodeBinary(const char *data, int size)
+{
+    int channels = plots.count();
+    int sample_size = SampleSize(type);
+    int payload = channels*sample_size;
+    int frame = sync.size()+payload+FrameChecksumSize(checksum);
+    int pos = 0;
+
+    while (size-pos >= frame)
+    {
+        const char *body = data+pos+sync.size();
+
+        if (memcmp(data+pos,sync.constData(),sync.size()))
+        {
+            const void *next = memchr(data+pos+1,sync[0],size-pos-1);
+
+            errors.fetch_add(1,std::memory_order_relaxed);
+            pos = next ? static_cast<const char*>(next)-data : size;
+            continue;
+        }
+
+        if (!FrameChecksumMatches(checksum,body,payload,body+payload,
+                                  big_endian))
+        {
+            errors.fetch_add(1,std::memory_order_relaxed);
+            pos++;
+            continue;
+        }
+
+        double x = x0+sample*dt;
+
+        for (int i = 0; i < channels; i++)
+        {
+            batch[i].append(QPointF(x,FrameSample(body+i*sample_size,
+                                                  type,big_endian)));
+        }
+
+        sample++;
+        frames.fetch_add(1,std::memory_order_relaxed);
+        pos += frame;
+    }
+
+    return pos;
+}
+
+// Lines with fewer numbers than channels are counted as errors, extra
+// fields are ignored. A line that never ends is dropped once it is
+// longer than ACQUISITION_MAX_LINE.
+int QOpenGL2DPlotAcquisition::DecodeAscii(const char *data, int size)
+{
+    int channels = plots.count();
+    int fields = channels+(x_column ? 1 : 0);
+    int pos = 0;
+
+    QVector<double> values(fields);
+
+    while (pos < size)
+    {
+        const char *line = data+pos;
+        const char *end = static_cast<const char*>(
+                    memchr(line,terminator,size-pos));
+
+        if (!end)
+        {
+            if (size-pos > ACQUISITION_MAX_LINE)
+            {
+                errors.fetch_add(1,std::memory_order_relaxed);
+                return size;
+            }
+
+            break;
+        }
+
+        int count = CsvParseLine(line,end,separator,values.data(),fields);
+
+        pos = end-data+1;
+
+        if (count < fields)
+        {
+            // Empty lines, e.g. the second half of CR LF, are not frames
+            if (end-line > 1 || (end-line == 1 && *line != '\r'))
+            {
+                errors.fetch_add(1,std::memory_order_relaxed);
+            }
+
+            continue;
+        }
+
+        double x = x_column ? values[0] : x0+sample*dt;
+        const double *y = values.constData()+(x_column ? 1 : 0);
+
+        for (int i = 0; i < channels; i++)
+        {
+            batch[i].append(QPointF(x,y[i]));
+        }
+
+        sample++;
+        frames.fetch_add(1,std::memory_order_relaxed);
+    }
+
+    return pos;
+}
+
+void QOpenGL2DPlotAcquisition::Flush()
+{
+    for (int i = 0; i < batch.count(); i++)
+    {
+        if (!batch[i].isEmpty())
+        {
+            producers[i]->push(batch[i]);
+            batch[i].resize(0);
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef QOPENGL2DPLOTACQUISITION_H
+#define QOPENGL2DPLOTACQUISITION_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QObject>
+#include <QPointF>
+#include <QString>
+#include <QThread>
+#include <QVector>
+
+#include <atomic>
+
+#include "QOpenGL2DPlot.h"
+
+// Reads an instrument stream on a worker thread, decodes it into frames
+// of one sample per channel and feeds channel i to plot plots[i] through
+// the plot's producer queue, one push per channel and read. The stream
+// is a serial port opened on the worker thread or any other QIODevice,
+// such as one end of a pseudo-terminal pair or an in-process stand-in.
+//
+// Binary frames are the sync bytes, one sample per channel in the given
+// type and byte order, then an optional checksum over the samples in the
+// same byte order. ASCII frames are lines of separated numbers, the
+// first one is X when x_column is set. Otherwise X is x0+i*dt for the
+// i-th frame. Framing and channels are set before start().
+class QOpenGL2DPlotAcquisition : public QObject
+{
+    Q_OBJECT
+public:
+    enum Framing {
+        Binary  = 0,
+        Ascii   = 1
+    };
+
+    enum Checksum {
+        NoChecksum  = 0,
+        Sum8        = 1,
+        Xor8        = 2,
+        Crc16       = 3
+    };
+
+private:
+    QOpenGL2DPlot *plot;
+    QThread *thread;
+    QIODevice *device;
+
+    QVector<int> plots;
+    QVector<QOpenGL2DPlotProducer*> producers;
+
+    Framing framing;
+    QByteArray sync;
+    QOpenGL2DPlot::SampleType type;
+    Checksum checksum;
+    bool big_endian;
+    char separator;
+    char terminator;
+    bool x_column;
+
+    double x0;
+    double dt;
+
+    // Only touched by the worker thread while running
+    qint64 sample;
+    QByteArray pending;
+    QVector<QVector<QPointF>> batch;
+
+    std::atomic<quint64> frames;
+    std::atomic<quint64> errors;
+    std::atomic<quint64> bytes;
+
+    void ReadDevice();
+    int DecodeBinary(const char *data, int size);
+    int DecodeAscii(const char *data, int size);
+    void Flush();
+
+public:
+    QOpenGL2DPlotAcquisition(QOpenGL2DPlot *plot, QObject *parent = 0);
+    ~QOpenGL2DPlotAcquisition();
+
+    void setChannels(const QVector<int> &plots);
+    void setSampleSpacing(double x0, double dt);
+
+    void setBinaryFraming(const QByteArray &sync,
+                          QOpenGL2DPlot::SampleType type,
+                          Checksum checksum = NoChecksum,
+                          bool big_endian = false);
+    void setAsciiFraming(char separator = ',', char terminator = '\n',
+                         bool x_column = false);
+
+    bool start(const QString &portName, qint32 baudRate);
+    bool start(QIODevice *device);
+    void stop();
+
+    bool isRunning() const;
+
+    quint64 Frames() const;
+    quint64 Errors() const;
+    quint64 Bytes() const;
+    quint64 Dropped() const;
+
+signals:
+    void error(const QString &message);
+};
+
+#endif // QOPENGL2DPLOTACQUISITION_H
@@ -0,0 +1,354 @@
+#include "QOpenGL2DPlotCapture.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <limits>
+
+#define CAPTURE_MAGIC               "Q2DPCAP1"
+#define CAPTURE_HEADER_SIZE         64
+#define CAPTURE_MIN_BUCKETS         512
+
+struct CaptureHeader {
+    char magic[8];
+    quint32 type;
+    quint32 columns;
+    qint64 count;
+    double x0;
+    double dt;
+    quint32 summary_factor;
+    quint32 summary_levels;
+    qint64 summary_offset;
+    qint64 reserved;
+};
+
+static_assert(sizeof(CaptureHeader) == CAPTURE_HEADER_SIZE,
+              "Capture header must be 64 bytes");
+
+// Level 0 is the raw data, each level above keeps a low/high pair per
+// bucket of the level below until fewer than CAPTURE_MIN_BUCKETS are
+// left, or levels summaries are laid out. Returns false when that does
+// not fit in limit bytes, sizes are compared before they are multiplied
+// so a malformed header cannot overflow them.
+bool CaptureLayout(qint64 count, int factor, int columns, int size,
+                   int levels, qint64 limit,
+                   QVector<qint64> &offset, QVector<qint64> &values)
+{
+    offset.clear();
+    values.clear();
+
+    if (columns < 1 || factor < 1 || count < 0)
+    {
+        return false;
+    }
+
+    qint64 stride = qint64(columns)*size;
+
+    if (count > (limit-CAPTURE_HEADER_SIZE)/stride)
+    {
+        return false;
+    }
+
+    offset.append(CAPTURE_HEADER_SIZE);
+    values.append(count);
+
+    qint64 end = CAPTURE_HEADER_SIZE+count*stride;
+    qint64 group = factor;
+
+    while (factor > 1 && offset.count() <= levels)
+    {
+        qint64 buckets = (values.last()+group-1)/group;
+
+        if (buckets < CAPTURE_MIN_BUCKETS)
+        {
+            break;
+        }
+
+        if (buckets > (limit-end)/stride/2)
+        {
+            return false;
+        }
+
+        offset.append(end);
+        values.append(buckets*2);
+
+        end += buckets*2*stride;
+        group = 2*factor;
+    }
+
+    return true;
+}
+
+template <typename T>
+void SummarizeLevel(const uchar *src, qint64 src_count, qint64 group,
+                    uchar *dst)
+{
+    const T *in = reinterpret_cast<const T*>(src);
+    T *out = reinterpret_cast<T*>(dst);
+
+    for (qint64 begin = 0, i = 0; begin < src_count; begin += group, i++)
+    {
+        qint64 end = std::min<qint64>(begin+group,src_count);
+        qint64 min = begin;
+        qint64 max = begin;
+
+        for (qint64 j = begin+1; j < end; j++)
+        {
+            if (in[j] < in[min])
+            {
+                min = j;
+            }
+            if (in[j] > in[max])
+            {
+                max = j;
+            }
+        }
+
+        out[i*2]   = in[std::min<qint64>(min,max)];
+        out[i*2+1] = in[std::max<qint64>(min,max)];
+    }
+}
+
+void SummarizeLevel(QOpenGL2DPlot::SampleType type, const uchar *src,
+                    qint64 src_count, qint64 group, uchar *dst)
+{
+    switch (type)
+    {
+    case QOpenGL2DPlot::Int16:
+        SummarizeLevel<qint16>(src,src_count,group,dst);
+        break;
+    case QOpenGL2DPlot::Int32:
+        SummarizeLevel<qint32>(src,src_count,group,dst);
+        break;
+    case QOpenGL2DPlot::Float:
+        SummarizeLevel<float>(src,src_count,group,dst);
+        break;
+    default:
+        SummarizeLevel<double>(src,src_count,group,dst);
+        break;
+    }
+}
+
+QOpenGL2DPlotCapture::QOpenGL2DPlotCapture():
+    map(nullptr),
+    type(QOpenGL2DPlot::Int16),
+    columns(0),
+    count(0),
+    x0(0),
+    dt(1),
+    summary_factor(0)
+{
+}
+
+QOpenGL2DPlotCapture::~QOpenGL2DPlotCapture()
+{
+    close();
+}
+
+bool QOpenGL2DPlotCapture::open(const QString &fileName)
+{
+    close();
+
+    file.setFileName(fileName);
+
+    if (!file.open(QIODevice::ReadOnly) ||
+        file.size() < CAPTURE_HEADER_SIZE)
+    {
+        close();
+        return false;
+    }
+
+    // Mapping only reserves address space, the OS pages data in on use
+    map = file.map(0,file.size());
+
+    if (!map)
+    {
+        close();
+        return false;
+    }
+
+    const CaptureHeader *header =
+            reinterpret_cast<const CaptureHeader*>(map);
+
+    // Counts are ints here, anything above INT_MAX is as bad as zero,
+    // and the time base has to give a finite sample index
+    if (memcmp(header->magic,CAPTURE_MAGIC,8) ||
+        header->type > QOpenGL2DPlot::Double ||
+        header->count < 0 ||
+        header->columns < 1 || header->columns > INT_MAX ||
+        header->summary_factor < 1 || header->summary_factor > INT_MAX ||
+        header->summary_levels > INT_MAX ||
+        !std::isfinite(header->dt) || header->dt <= 0 ||
+        !std::isfinite(header->x0))
+    {
+        close();
+        return false;
+    }
+
+    type           = QOpenGL2DPlot::SampleType(header->type);
+    columns        = header->columns;
+    count          = header->count;
+    x0             = header->x0;
+    dt             = header->dt;
+    summary_factor = header->summary_factor;
+
+    int size = SampleSize(type);
+
+    if (!CaptureLayout(count,summary_factor,columns,size,
+                       header->summary_levels,file.size(),
+                       level_offset,level_count) ||
+        (level_offset.count() > 1 &&
+         level_offset[1] != header->summary_offset))
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void QOpenGL2DPlotCapture::close()
+{
+    if (map)
+    {
+        file.unmap(map);
+        map = nullptr;
+    }
+
+    file.close();
+
+    columns = 0;
+    count = 0;
+    level_offset.clear();
+    level_count.clear();
+}
+
+bool QOpenGL2DPlotCapture::isOpen() const
+{
+    return map != nullptr;
+}
+
+QOpenGL2DPlot::SampleType QOpenGL2DPlotCapture::Type() const
+{
+    return type;
+}
+
+int QOpenGL2DPlotCapture::Columns() const
+{
+    return columns;
+}
+
+qint64 QOpenGL2DPlotCapture::Count() const
+{
+    return count;
+}
+
+double QOpenGL2DPlotCapture::X0() const
+{
+    return x0;
+}
+
+double QOpenGL2DPlotCapture::Dt() const
+{
+    return dt;
+}
+
+int QOpenGL2DPlotCapture::SummaryFactor() const
+{
+    return summary_factor;
+}
+
+int QOpenGL2DPlotCapture::SummaryLevels() const
+{
+    return std::max<int>(level_count.count()-1,0);
+}
+
+qint64 QOpenGL2DPlotCapture::LevelCount(int level) const
+{
+    return level_count[level];
+}
+
+const char *QOpenGL2DPlotCapture::Column(int column, int level) const
+{
+    return reinterpret_cast<const char*>(map)+level_offset[level]+
+            column*level_count[level]*SampleSize(type);
+}
+
+// The file is sized up front and filled through a writable mapping, so
+// summaries of large captures do not have to fit in memory.
+bool QOpenGL2DPlotCapture::write(const QString &fileName,
+                                 QOpenGL2DPlot::SampleType type,
+                                 const QVector<const void*> &columns,
+                                 qint64 count, double x0, double dt,
+                                 int summary_factor)
+{
+    int size = SampleSize(type);
+    int column_count = columns.count();
+
+    QVector<qint64> offset;
+    QVector<qint64> values;
+
+    if (!std::isfinite(dt) || dt <= 0 || !std::isfinite(x0))
+    {
+        return false;
+    }
+
+    if (!CaptureLayout(count,summary_factor,column_count,size,INT_MAX,
+                       std::numeric_limits<qint64>::max(),offset,values))
+    {
+        return false;
+    }
+
+    qint64 end = offset.last()+column_count*values.last()*size;
+
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate) ||
+        !file.resize(end))
+    {
+        return false;
+    }
+
+    uchar *map = file.map(0,end);
+
+    if (!map)
+    {
+        return false;
+    }
+
+    CaptureHeader *header = reinterpret_cast<CaptureHeader*>(map);
+
+    memcpy(header->magic,CAPTURE_MAGIC,8);
+    header->type           = type;
+    header->columns        = column_count;
+    header->count          = count;
+    header->x0             = x0;
+    header->dt             = dt;
+    header->summary_factor = summary_factor;
+    header->summary_levels = offset.count()-1;
+    header->summary_offset = offset.count() > 1 ? offset[1] : end;
+    header->reserved       = 0;
+
+    for (int i = 0; i < column_count; i++)
+    {
+        memcpy(map+offset[0]+i*count*size,columns[i],count*size);
+    }
+
+    for (int level = 1; level < offset.count(); level++)
+    {
+        qint64 group = level == 1 ? summary_factor : 2*summary_factor;
+
+        for (int i = 0; i < column_count; i++)
+        {
+            SummarizeLevel(type,
+                           map+offset[level-1]+i*values[level-1]*size,
+                           values[level-1],group,
+                           map+offset[level]+i*values[level]*size);
+        }
+    }
+
+    file.unmap(map);
+    file.close();
+
+    return true;
+}
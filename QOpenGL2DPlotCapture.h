@@ -0,0 +1,73 @@
+#ifndef QOPENGL2DPLOTCAPTURE_H
+#define QOPENGL2DPLOTCAPTURE_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include "QOpenGL2DPlot.h"
+
+// Read-only, memory-mapped capture file of uniformly sampled channels.
+// The file holds a 64 byte header, one raw column per channel and a
+// min/max summary pyramid per channel. Nothing is read on open, pages
+// are only touched when a plot shows them.
+//
+// Layout, in host byte order:
+//   0   char[8]  "Q2DPCAP1"
+//   8   quint32  sample type (QOpenGL2DPlot::SampleType)
+//   12  quint32  column count
+//   16  qint64   samples per column
+//   24  double   x0
+//   32  double   dt, finite and positive
+//   40  quint32  summary factor, samples per level 1 bucket
+//   44  quint32  summary levels
+//   48  qint64   offset of the first summary level
+//   56  qint64   reserved
+// Level l holds a low/high pair per factor^l samples, in index order,
+// levels are stored one after the other with all columns of a level
+// next to each other.
+class QOpenGL2DPlotCapture
+{
+private:
+    QFile file;
+    uchar *map;
+
+    QOpenGL2DPlot::SampleType type;
+    int columns;
+    qint64 count;
+    double x0;
+    double dt;
+    int summary_factor;
+
+    QVector<qint64> level_offset;
+    QVector<qint64> level_count;
+
+public:
+    QOpenGL2DPlotCapture();
+    ~QOpenGL2DPlotCapture();
+
+    bool open(const QString &fileName);
+    void close();
+
+    bool isOpen() const;
+
+    QOpenGL2DPlot::SampleType Type() const;
+    int Columns() const;
+    qint64 Count() const;
+    double X0() const;
+    double Dt() const;
+
+    int SummaryFactor() const;
+    int SummaryLevels() const;
+
+    qint64 LevelCount(int level) const;
+    const char *Column(int column, int level = 0) const;
+
+    static bool write(const QString &fileName,
+                      QOpenGL2DPlot::SampleType type,
+                      const QVector<const void*> &columns, qint64 count,
+                      double x0 = 0, double dt = 1,
+                      int summary_factor = 64);
+};
+
+#endif // QOPENGL2DPLOTCAPTURE_H
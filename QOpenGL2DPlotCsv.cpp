@@ -0,0 +1,640 @@
+#include "QOpenGL2DPlotCsv.h"
+
+#include <QThread>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CSV_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || \
+      (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CSV_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define CSV_BLOCK_SIZE              64
+#define CSV_MIN_CHUNK_SIZE          (1 << 20)
+#define CSV_SAMPLE_SIZE             4096
+#define CSV_MAX_DIGITS              19
+#define CSV_EXACT_POWER             22
+#define CSV_EXACT_MANTISSA          (Q_UINT64_C(1) << 53)
+
+typedef quint64 (*CsvMaskFunction)(const char *data, char separator,
+                                   char terminator);
+
+struct CsvChunk {
+    const char *begin;
+    const char *end;
+    char separator;
+    char terminator;
+    int column_count;
+    CsvMaskFunction mask;
+    QVector<QVector<double>> columns;
+    qint64 errors;
+};
+
+#ifdef QOPENGL2DPLOT_CSV_AVX2
+// QOpenGL2DPlotCsvAvx2.cpp, built with AVX2 enabled
+quint64 CsvStructuralMaskAvx2(const char *data, char separator,
+                              char terminator);
+#endif
+
+// Bit i is set when byte i of the 64 bytes at data is a separator or a
+// line end.
+quint64 CsvStructuralMask(const char *data, char separator,
+                          char terminator)
+{
+    quint64 mask = 0;
+
+#if defined(CSV_AVX2)
+    __m256i sep  = _mm256_set1_epi8(separator);
+    __m256i term = _mm256_set1_epi8(terminator);
+
+    for (int i = 0; i < CSV_BLOCK_SIZE; i += 32)
+    {
+        __m256i block = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(data+i));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(block,sep),
+                                      _mm256_cmpeq_epi8(block,term));
+
+        mask |= quint64(quint32(_mm256_movemask_epi8(hit))) << i;
+    }
+#elif defined(CSV_SSE2)
+    __m128i sep  = _mm_set1_epi8(separator);
+    __m128i term = _mm_set1_epi8(terminator);
+
+    for (int i = 0; i < CSV_BLOCK_SIZE; i += 16)
+    {
+        __m128i block = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(data+i));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(block,sep),
+                                   _mm_cmpeq_epi8(block,term));
+
+        mask |= quint64(quint16(_mm_movemask_epi8(hit))) << i;
+    }
+#else
+    for (int i = 0; i < CSV_BLOCK_SIZE; i++)
+    {
+        if (data[i] == separator || data[i] == terminator)
+        {
+            mask |= Q_UINT64_C(1) << i;
+        }
+    }
+#endif
+
+    return mask;
+}
+
+#ifdef QOPENGL2DPLOT_CSV_AVX2
+bool CsvHasAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info,1);
+
+    // The OS has to save the YMM registers as well
+    bool avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+            (_xgetbv(0) & 6) == 6;
+
+    __cpuidex(info,7,0);
+
+    return avx && (info[1] & (1 << 5));
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+// The AVX2 kernel is picked at run time when the CPU has it, the build
+// itself only has to target the baseline.
+CsvMaskFunction CsvSelectMask()
+{
+#ifdef QOPENGL2DPLOT_CSV_AVX2
+    if (CsvHasAvx2())
+    {
+        return CsvStructuralMaskAvx2;
+    }
+#endif
+
+    return CsvStructuralMask;
+}
+
+int CsvLowestBit(quint64 mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index,mask);
+    return index;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+bool CsvBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool CsvBlankLine(const char *begin, const char *end)
+{
+    return std::all_of(begin,end,CsvBlank);
+}
+
+bool CsvMatch(const char *begin, const char *end, const char *word)
+{
+    int length = strlen(word);
+
+    if (end-begin != length)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < length; i++)
+    {
+        if ((begin[i] | 0x20) != word[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Up to 19 significant digits are kept in an integer. Within the range
+// where both the digits and the power of ten are exact doubles a single
+// multiplication or division is correctly rounded, beyond it the result
+// is computed in long double.
+double CsvScale(quint64 mantissa, int exponent)
+{
+    static const double powers[CSV_EXACT_POWER+1] = {
+        1E0,  1E1,  1E2,  1E3,  1E4,  1E5,  1E6,  1E7,
+        1E8,  1E9,  1E10, 1E11, 1E12, 1E13, 1E14, 1E15,
+        1E16, 1E17, 1E18, 1E19, 1E20, 1E21, 1E22
+    };
+
+    if (mantissa < CSV_EXACT_MANTISSA &&
+        exponent >= -CSV_EXACT_POWER && exponent <= CSV_EXACT_POWER)
+    {
+        return exponent < 0 ? mantissa/powers[-exponent] :
+                              mantissa*powers[exponent];
+    }
+
+    return double((long double)(mantissa)*powl(10.0L,exponent));
+}
+
+bool CsvParseNumber(const char *begin, const char *end, double &value)
+{
+    while (begin < end && CsvBlank(*begin))
+    {
+        begin++;
+    }
+
+    while (end > begin && CsvBlank(end[-1]))
+    {
+        end--;
+    }
+
+    const char *p = begin;
+    bool negative = false;
+
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+
+    quint64 mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+
+    for (; p < end && unsigned(*p-'0') < 10; p++, any = true)
+    {
+        if (digits < CSV_MAX_DIGITS)
+        {
+            mantissa = mantissa*10+(*p-'0');
+            digits += mantissa != 0;
+        }
+        else
+        {
+            exponent++;
+        }
+    }
+
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && unsigned(*p-'0') < 10; p++, any = true)
+        {
+            if (digits < CSV_MAX_DIGITS)
+            {
+                mantissa = mantissa*10+(*p-'0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+
+    if (!any)
+    {
+        if (CsvMatch(p,end,"nan"))
+        {
+            value = NAN;
+            return true;
+        }
+
+        if (CsvMatch(p,end,"inf") || CsvMatch(p,end,"infinity"))
+        {
+            value = negative ? -INFINITY : INFINITY;
+            return true;
+        }
+
+        return false;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        bool exponent_negative = false;
+        bool exponent_any = false;
+        int e = 0;
+
+        p++;
+
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            exponent_negative = *p == '-';
+            p++;
+        }
+
+        for (; p < end && unsigned(*p-'0') < 10; p++, exponent_any = true)
+        {
+            e = std::min<int>(e*10+(*p-'0'),100000);
+        }
+
+        if (!exponent_any)
+        {
+            return false;
+        }
+
+        exponent += exponent_negative ? -e : e;
+    }
+
+    if (p != end)
+    {
+        return false;
+    }
+
+    value = CsvScale(mantissa,exponent);
+
+    if (negative)
+    {
+        value = -value;
+    }
+
+    return true;
+}
+
+int CsvParseLine(const char *begin, const char *end, char separator,
+                 double *values, int count)
+{
+    int field = 0;
+
+    while (field < count)
+    {
+        const char *next = static_cast<const char*>(
+                    memchr(begin,separator,end-begin));
+
+        if (!next)
+        {
+            next = end;
+        }
+
+        if (!CsvParseNumber(begin,next,values[field]))
+        {
+            return -1;
+        }
+
+        field++;
+
+        if (next == end)
+        {
+            break;
+        }
+
+        begin = next+1;
+    }
+
+    return field;
+}
+
+void CsvAppendRow(CsvChunk *chunk, const double *row, int columns,
+                  int fields, bool ok, const char *line, const char *end)
+{
+    if (ok && fields >= columns)
+    {
+        for (int i = 0; i < columns; i++)
+        {
+            chunk->columns[i].append(row[i]);
+        }
+    }
+    else if (!CsvBlankLine(line,end))
+    {
+        chunk->errors++;
+    }
+}
+
+// Rows of [begin, end) estimated from the line ends in its first
+// CSV_SAMPLE_SIZE bytes, at most what the shortest possible lines would
+// give. Columns still grow past it when it is low.
+qint64 CsvEstimateRows(const char *begin, const char *end, char terminator,
+                       int columns)
+{
+    qint64 size = end-begin;
+    qint64 sample = std::min<qint64>(size,CSV_SAMPLE_SIZE);
+    qint64 lines = std::max<qint64>(
+                std::count(begin,begin+sample,terminator),1);
+
+    return std::min<qint64>(size*lines/std::max<qint64>(sample,1)+1,
+                            size/(2*columns)+1);
+}
+
+// Field boundaries come from the structural masks, so every byte is
+// compared once by the vector unit and the number parser only sees the
+// bytes of one field.
+void CsvParseChunk(CsvChunk &chunk)
+{
+    const char *p = chunk.begin;
+    const char *end = chunk.end;
+    const char *field_begin = p;
+    const char *line = p;
+    char separator = chunk.separator;
+    char terminator = chunk.terminator;
+    int columns = chunk.column_count;
+    int field = 0;
+    bool ok = true;
+
+    QVector<double> row(columns);
+    double *values = row.data();
+
+    qint64 rows = CsvEstimateRows(p,end,terminator,columns);
+
+    chunk.columns.resize(columns);
+    chunk.errors = 0;
+
+    for (int i = 0; i < columns; i++)
+    {
+        chunk.columns[i].reserve(rows);
+    }
+
+    char block[CSV_BLOCK_SIZE];
+
+    while (p < end)
+    {
+        int n = std::min<qint64>(CSV_BLOCK_SIZE,end-p);
+        quint64 mask;
+
+        if (n == CSV_BLOCK_SIZE)
+        {
+            mask = chunk.mask(p,separator,terminator);
+        }
+        else
+        {
+            memcpy(block,p,n);
+            mask = chunk.mask(block,separator,terminator) &
+                    ((Q_UINT64_C(1) << n)-1);
+        }
+
+        while (mask)
+        {
+            const char *stop = p+CsvLowestBit(mask);
+            mask &= mask-1;
+
+            if (field < columns)
+            {
+                ok = ok && CsvParseNumber(field_begin,stop,values[field]);
+            }
+
+            field++;
+            field_begin = stop+1;
+
+            if (*stop == terminator)
+            {
+                CsvAppendRow(&chunk,values,columns,field,ok,line,stop);
+
+                field = 0;
+                ok = true;
+                line = stop+1;
+            }
+        }
+
+        p += n;
+    }
+
+    // Last line without a line end
+    if (line < end)
+    {
+        if (field < columns)
+        {
+            ok = ok && CsvParseNumber(field_begin,end,values[field]);
+        }
+
+        CsvAppendRow(&chunk,values,columns,field+1,ok,line,end);
+    }
+}
+
+QOpenGL2DPlotCsv::QOpenGL2DPlotCsv():
+    separator(','),
+    terminator('\n'),
+    skip_lines(0),
+    threads(QThread::idealThreadCount()),
+    errors(0)
+{
+}
+
+void QOpenGL2DPlotCsv::setSeparator(char separator)
+{
+    this->separator = separator;
+}
+
+void QOpenGL2DPlotCsv::setTerminator(char terminator)
+{
+    this->terminator = terminator;
+}
+
+void QOpenGL2DPlotCsv::setSkipLines(int lines)
+{
+    skip_lines = std::max<int>(lines,0);
+}
+
+void QOpenGL2DPlotCsv::setThreads(int threads)
+{
+    this->threads = std::max<int>(threads,1);
+}
+
+// Chunks end right after a line end, so no line is split between two
+// threads and the columns of consecutive chunks are simply appended.
+bool QOpenGL2DPlotCsv::parse(const char *data, qint64 size)
+{
+    clear();
+
+    const char *p = data;
+    const char *end = data+size;
+
+    for (int i = 0; i < skip_lines && p < end; i++)
+    {
+        const char *next = static_cast<const char*>(
+                    memchr(p,terminator,end-p));
+        p = next ? next+1 : end;
+    }
+
+    const char *first_end = static_cast<const char*>(
+                memchr(p,terminator,end-p));
+
+    if (!first_end)
+    {
+        first_end = end;
+    }
+
+    if (p >= end || CsvBlankLine(p,first_end))
+    {
+        return false;
+    }
+
+    int column_count = 1+std::count(p,first_end,separator);
+    int chunk_count = qBound<qint64>(1,(end-p)/CSV_MIN_CHUNK_SIZE,threads);
+    CsvMaskFunction mask = CsvSelectMask();
+
+    QVector<CsvChunk> chunks(chunk_count);
+    CsvChunk *chunk = chunks.data();
+
+    for (int i = 0; i < chunk_count; i++)
+    {
+        const char *split = p+(end-p)*(i+1)/chunk_count;
+
+        chunk[i].begin        = i ? chunk[i-1].end : p;
+        chunk[i].end          = end;
+        chunk[i].separator    = separator;
+        chunk[i].terminator   = terminator;
+        chunk[i].column_count = column_count;
+        chunk[i].mask         = mask;
+
+        if (i < chunk_count-1 && split > chunk[i].begin)
+        {
+            const char *next = static_cast<const char*>(
+                        memchr(split,terminator,end-split));
+            chunk[i].end = next ? next+1 : end;
+        }
+        else if (i < chunk_count-1)
+        {
+            chunk[i].end = chunk[i].begin;
+        }
+    }
+
+    if (chunk_count > 1)
+    {
+        QtConcurrent::blockingMap(chunks,CsvParseChunk);
+    }
+    else
+    {
+        CsvParseChunk(chunk[0]);
+    }
+
+    chunk = chunks.data();
+
+    columns.swap(chunk[0].columns);
+    errors = chunk[0].errors;
+
+    for (int i = 1; i < chunk_count; i++)
+    {
+        for (int c = 0; c < column_count; c++)
+        {
+            columns[c] += chunk[i].columns[c];
+        }
+
+        errors += chunk[i].errors;
+    }
+
+    return true;
+}
+
+// The file is mapped rather than read, so a large capture is parsed
+// straight from the page cache.
+bool QOpenGL2DPlotCsv::open(const QString &fileName)
+{
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0)
+    {
+        clear();
+        return false;
+    }
+
+    uchar *map = file.map(0,file.size());
+
+    if (!map)
+    {
+        clear();
+        return false;
+    }
+
+    bool ok = parse(reinterpret_cast<const char*>(map),file.size());
+
+    file.unmap(map);
+
+    return ok;
+}
+
+void QOpenGL2DPlotCsv::clear()
+{
+    columns.clear();
+    errors = 0;
+}
+
+int QOpenGL2DPlotCsv::Columns() const
+{
+    return columns.count();
+}
+
+qint64 QOpenGL2DPlotCsv::Rows() const
+{
+    return columns.isEmpty() ? 0 : columns.first().count();
+}
+
+qint64 QOpenGL2DPlotCsv::Errors() const
+{
+    return errors;
+}
+
+const QVector<double> &QOpenGL2DPlotCsv::Column(int column) const
+{
+    return columns[column];
+}
+
+// Columns go to the plot as double sample columns, without X the
+// samples are spaced by x0 and dt.
+void QOpenGL2DPlotCsv::loadPlot(QOpenGL2DPlot *plot, int plot_index,
+                                int y_column, int x_column,
+                                double x0, double dt) const
+{
+    const QVector<double> &y = columns[y_column];
+
+    if (x_column < 0)
+    {
+        plot->setSamples(plot_index,y.constData(),QOpenGL2DPlot::Double,
+                         y.count(),x0,dt);
+    }
+    else
+    {
+        plot->setSamples(plot_index,
+                         columns[x_column].constData(),QOpenGL2DPlot::Double,
+                         y.constData(),QOpenGL2DPlot::Double,y.count());
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef QOPENGL2DPLOTCSV_H
+#define QOPENGL2DPLOTCSV_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include "QOpenGL2DPlot.h"
+
+// Parses delimited numeric text, such as CSV captures, into one column
+// of doubles per field. The buffer is split on line boundaries into up
+// to threads chunks, parsed on the global thread pool. Each chunk is
+// scanned 64 bytes at a time for separators and line ends, with AVX2
+// when the CPU has it and SSE2 otherwise on x86, then every field is
+// converted in place without allocating.
+// Lines with fewer fields than the first data line are skipped and
+// counted as errors, extra fields are ignored.
+class QOpenGL2DPlotCsv
+{
+private:
+    char separator;
+    char terminator;
+    int skip_lines;
+    int threads;
+
+    QVector<QVector<double>> columns;
+    qint64 errors;
+
+public:
+    QOpenGL2DPlotCsv();
+
+    void setSeparator(char separator);
+    void setTerminator(char terminator);
+    void setSkipLines(int lines);
+    void setThreads(int threads);
+
+    bool parse(const char *data, qint64 size);
+    bool open(const QString &fileName);
+    void clear();
+
+    int Columns() const;
+    qint64 Rows() const;
+    qint64 Errors() const;
+
+    const QVector<double> &Column(int column) const;
+
+    void loadPlot(QOpenGL2DPlot *plot, int plot_index, int y_column,
+                  int x_column = -1, double x0 = 0,
+                  double dt = 1) const;
+};
+
+// Converts the number in [begin, end), surrounding blanks and a trailing
+// carriage return are ignored. Returns false when it is not a number.
+bool CsvParseNumber(const char *begin, const char *end, double &value);
+
+// Parses up to count separated numbers of the line [begin, end) into
+// values. Returns the number of fields converted, -1 on a bad field.
+int CsvParseLine(const char *begin, const char *end, char separator,
+                 double *values, int count);
+
+#endif // QOPENGL2DPLOTCSV_H
@@ -0,0 +1,26 @@
+#include <QtGlobal>
+
+#include <immintrin.h>
+
+// Built with AVX2 enabled and only called once the CPU is known to have
+// it, see CsvSelectMask(). Same result as CsvStructuralMask() for the 64
+// bytes at data.
+quint64 CsvStructuralMaskAvx2(const char *data, char separator,
+                              char terminator)
+{
+    __m256i sep  = _mm256_set1_epi8(separator);
+    __m256i term = _mm256_set1_epi8(terminator);
+    quint64 mask = 0;
+
+    for (int i = 0; i < 64; i += 32)
+    {
+        __m256i block = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(data+i));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(block,sep),
+                                      _mm256_cmpeq_epi8(block,term));
+
+        mask |= quint64(quint32(_mm256_movemask_epi8(hit))) << i;
+    }
+
+    return mask;
+}
@@ -0,0 +1,105 @@
+#include "QOpenGL2DPlotProducer.h"
+#include "QOpenGL2DPlot.h"
+
+#include <QMetaObject>
+
+#include <algorithm>
+
+QOpenGL2DPlotProducer::QOpenGL2DPlotProducer(QOpenGL2DPlot *plot,
+                                             int capacity):
+    plot(plot),
+    head(0),
+    tail(0),
+    dropped(0),
+    notified(false)
+{
+    int size = 1;
+
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+
+    buffer = new QPointF[size];
+    mask = size-1;
+}
+
+QOpenGL2DPlotProducer::~QOpenGL2DPlotProducer()
+{
+    delete[] buffer;
+}
+
+int QOpenGL2DPlotProducer::push(const QPointF &point)
+{
+    return push(&point,1);
+}
+
+int QOpenGL2DPlotProducer::push(const QVector<QPointF> &points)
+{
+    return push(points.constData(),points.count());
+}
+
+int QOpenGL2DPlotProducer::push(const QPointF *points, int count)
+{
+    quint64 h = head.load(std::memory_order_relaxed);
+    quint64 t = tail.load(std::memory_order_acquire);
+
+    int space = mask+1-int(h-t);
+    int n = std::min<int>(count,space);
+
+    int index = h & mask;
+    int first = std::min<int>(n,mask+1-index);
+
+    std::copy(points,points+first,buffer+index);
+    std::copy(points+first,points+n,buffer);
+
+    head.store(h+n,std::memory_order_release);
+
+    if (n < count)
+    {
+        dropped.fetch_add(count-n,std::memory_order_relaxed);
+    }
+
+    // One queued repaint per frame, re-armed when the widget drains
+    if (n > 0 && !notified.exchange(true,std::memory_order_acq_rel))
+    {
+        QMetaObject::invokeMethod(plot,"scheduleUpdate",
+                                  Qt::QueuedConnection);
+    }
+
+    return n;
+}
+
+int QOpenGL2DPlotProducer::pop(QPointF *points, int count)
+{
+    quint64 t = tail.load(std::memory_order_relaxed);
+    quint64 h = head.load(std::memory_order_acquire);
+
+    int n = std::min<int>(count,int(h-t));
+
+    int index = t & mask;
+    int first = std::min<int>(n,mask+1-index);
+
+    std::copy(buffer+index,buffer+index+first,points);
+    std::copy(buffer,buffer+n-first,points+first);
+
+    tail.store(t+n,std::memory_order_release);
+
+    return n;
+}
+
+int QOpenGL2DPlotProducer::Capacity() const
+{
+    return mask+1;
+}
+
+int QOpenGL2DPlotProducer::Pending() const
+{
+    return int(head.load(std::memory_order_acquire)-
+               tail.load(std::memory_order_acquire));
+}
+
+quint64 QOpenGL2DPlotProducer::Dropped() const
+{
+    return dropped.load(std::memory_order_relaxed);
+}
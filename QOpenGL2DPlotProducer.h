@@ -0,0 +1,52 @@
+#ifndef QOPENGL2DPLOTPRODUCER_H
+#define QOPENGL2DPLOTPRODUCER_H
+
+#include <QPointF>
+#include <QVector>
+
+#include <atomic>
+
+class QOpenGL2DPlot;
+
+// Single producer, single consumer queue of points feeding one plot.
+// One thread may push into it while the widget drains it at frame time;
+// pushes never block and points that do not fit are dropped. The first
+// push after a drain posts a queued repaint to the widget, which
+// allocates an event; the pushes after it until the next drain only
+// copy into the ring.
+//
+// The widget owns its producers and deletes them in its destructor, so
+// the pushing thread has to be stopped before the plot is destroyed.
+class QOpenGL2DPlotProducer
+{
+    friend class QOpenGL2DPlot;
+
+private:
+    QOpenGL2DPlot *plot;
+    QPointF *buffer;
+    int mask;
+
+    std::atomic<quint64> head;
+    char head_pad[64];
+    std::atomic<quint64> tail;
+    char tail_pad[64];
+
+    std::atomic<quint64> dropped;
+    std::atomic<bool> notified;
+
+    QOpenGL2DPlotProducer(QOpenGL2DPlot *plot, int capacity);
+    ~QOpenGL2DPlotProducer();
+
+    int pop(QPointF *points, int count);
+
+public:
+    int push(const QPointF &point);
+    int push(const QPointF *points, int count);
+    int push(const QVector<QPointF> &points);
+
+    int Capacity() const;
+    int Pending() const;
+    quint64 Dropped() const;
+};
+
+#endif // QOPENGL2DPLOTPRODUCER_H
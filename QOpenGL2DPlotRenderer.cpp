@@ -0,0 +1,128 @@
+#include "QOpenGL2DPlotRenderer.h"
+
+#include <QFile>
+#include <QFileInfo>
+
+QOpenGL2DPlotRenderer::QOpenGL2DPlotRenderer(int samples,
+                                             const QSurfaceFormat &format):
+    fbo(nullptr),
+    samples(samples)
+{
+    surface.setFormat(format);
+    surface.create();
+
+    context.setFormat(format);
+    context.create();
+}
+
+// The framebuffer belongs to the context, it is only freed when the
+// context is usable from here, otherwise it goes with the context.
+QOpenGL2DPlotRenderer::~QOpenGL2DPlotRenderer()
+{
+    if (fbo && context.thread() == QThread::currentThread() &&
+        context.makeCurrent(&surface))
+    {
+        delete fbo;
+        context.doneCurrent();
+    }
+}
+
+bool QOpenGL2DPlotRenderer::isValid() const
+{
+    return surface.isValid() && context.isValid();
+}
+
+// Called on the thread the renderer is used from until now, e.g. by the
+// worker to hand it back to the GUI thread before it is deleted.
+void QOpenGL2DPlotRenderer::moveToThread(QThread *thread)
+{
+    context.moveToThread(thread);
+}
+
+// Returns a null image when the context is unusable or the plot belongs
+// to another renderer.
+QImage QOpenGL2DPlotRenderer::render(QOpenGL2DPlot *plot, const QSize &size)
+{
+    if (size.isEmpty() || !context.makeCurrent(&surface))
+    {
+        return QImage();
+    }
+
+    if (!fbo || fbo->size() != size)
+    {
+        QOpenGLFramebufferObjectFormat fbo_format;
+        fbo_format.setAttachment(
+                    QOpenGLFramebufferObject::CombinedDepthStencil);
+        fbo_format.setSamples(samples);
+
+        delete fbo;
+        fbo = new QOpenGLFramebufferObject(size,fbo_format);
+    }
+
+    QImage image;
+
+    if (fbo->isValid() && plot->RenderOffscreen(size,fbo->handle()))
+    {
+        // Resolves the samples first when the framebuffer has any
+        image = fbo->toImage();
+    }
+
+    QOpenGLFramebufferObject::bindDefault();
+    context.doneCurrent();
+
+    return image;
+}
+
+// Files ending in .rgba or .raw get the bare RGBA8888 pixels, top row
+// first, anything else is written by QImage in the format of its suffix.
+bool QOpenGL2DPlotRenderer::save(QOpenGL2DPlot *plot, const QSize &size,
+                                 const QString &fileName)
+{
+    QImage image = render(plot,size);
+
+    if (image.isNull())
+    {
+        return false;
+    }
+
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+
+    if (suffix != "rgba" && suffix != "raw")
+    {
+        return image.save(fileName);
+    }
+
+    image = image.convertToFormat(QImage::Format_RGBA8888);
+
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+
+    qint64 row = qint64(image.width())*4;
+
+    for (int y = 0; y < image.height(); y++)
+    {
+        if (file.write(reinterpret_cast<const char*>(image.constScanLine(y)),
+                       row) != row)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void QOpenGL2DPlotRenderer::release(QOpenGL2DPlot *plot)
+{
+    if (!context.makeCurrent(&surface))
+    {
+        return;
+    }
+
+    plot->ReleaseGL();
+
+    context.doneCurrent();
+}
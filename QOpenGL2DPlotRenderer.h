@@ -0,0 +1,49 @@
+#ifndef QOPENGL2DPLOTRENDERER_H
+#define QOPENGL2DPLOTRENDERER_H
+
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QSize>
+#include <QString>
+#include <QSurfaceFormat>
+#include <QThread>
+
+#include "QOpenGL2DPlot.h"
+
+// Draws plots without a window, into a framebuffer object of its own
+// context on an offscreen surface, e.g. under Mesa llvmpipe or EGL
+// surfaceless. Plots are set up as usual but never shown.
+//
+// The surface has to be created on the GUI thread, so renderers are
+// constructed there and may then be moved to a worker thread, one
+// renderer per thread. A plot keeps its GL objects in the context of the
+// first renderer that draws it, it is only drawn by that renderer and
+// must not change while it draws. Before a plot is deleted on the GUI
+// thread, release() frees them on the renderer's thread, which then
+// moves the renderer back to the GUI thread to be deleted.
+class QOpenGL2DPlotRenderer
+{
+private:
+    QOffscreenSurface surface;
+    QOpenGLContext context;
+    QOpenGLFramebufferObject *fbo;
+    int samples;
+
+public:
+    QOpenGL2DPlotRenderer(int samples = 4,
+                          const QSurfaceFormat &format =
+                          QSurfaceFormat::defaultFormat());
+    ~QOpenGL2DPlotRenderer();
+
+    bool isValid() const;
+    void moveToThread(QThread *thread);
+
+    QImage render(QOpenGL2DPlot *plot, const QSize &size);
+    bool save(QOpenGL2DPlot *plot, const QSize &size,
+              const QString &fileName);
+    void release(QOpenGL2DPlot *plot);
+};
+
+#endif // QOPENGL2DPLOTRENDERER_H
@@ -0,0 +1,30 @@
+#-------------------------------------------------
+#
+# Headless benchmark of QOpenGL2DPlot
+#
+#-------------------------------------------------
+
+QT       += core gui
+QT       += opengl
+QT       += svg
+QT       += concurrent
+
+CONFIG += c++14
+CONFIG += console
+CONFIG -= app_bundle
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = QOpenGL2DPlotBenchmark
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+SOURCES += main.cpp \
+    ../QOpenGL2DPlot.cpp \
+    ../QOpenGL2DPlotProducer.cpp \
+    ../QOpenGL2DPlotCapture.cpp
+
+HEADERS  += ../QOpenGL2DPlot.h \
+    ../QOpenGL2DPlotProducer.h \
+    ../QOpenGL2DPlotCapture.h
@@ -0,0 +1,394 @@
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThreadPool>
+
+#include "QOpenGL2DPlot.h"
+
+// Runs the widget without a window, on the offscreen platform plugin
+// unless another one is forced, and prints one line per measurement.
+// Frames are timed through grabFramebuffer(), so they include the
+// readback; the "frame" row of the empty configuration is that cost.
+// The geometry and grid rows are percentiles of the widget's own stage
+// timings over all frames of a configuration.
+
+#define APPEND_BLOCK                4096
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+#define BENCH_ENDL                  Qt::endl
+#define BENCH_SKIP_EMPTY            Qt::SkipEmptyParts
+#else
+#define BENCH_ENDL                  endl
+#define BENCH_SKIP_EMPTY            QString::SkipEmptyParts
+#endif
+
+struct BenchConfig {
+    QList<qint64> points;
+    QList<int> plots;
+    qint64 max_total;
+    qint64 max_svg;
+    int repeat;
+    QSize size;
+    bool json;
+};
+
+class BenchOutput
+{
+private:
+    QTextStream out;
+    bool json;
+
+public:
+    BenchOutput(bool json):
+        out(stdout),
+        json(json)
+    {
+        if (!json)
+        {
+            out << "stage,points,plots,iterations,mean_s,min_s,"
+                   "points_per_s" << BENCH_ENDL;
+        }
+    }
+
+    void write(const QString &stage, qint64 points, int plots,
+               const QVector<double> &times, qint64 work = 0)
+    {
+        double mean = 0;
+        double min = times.isEmpty() ? 0 : times.first();
+
+        for (double t : times)
+        {
+            mean += t;
+            min = std::min<double>(min,t);
+        }
+
+        mean /= std::max<int>(times.count(),1);
+
+        double rate = (work && mean > 0) ? work/mean : 0;
+
+        if (json)
+        {
+            out << "{\"stage\":\"" << stage << "\",\"points\":" << points
+                << ",\"plots\":" << plots << ",\"iterations\":"
+                << times.count() << ",\"mean_s\":" << mean
+                << ",\"min_s\":" << min << ",\"points_per_s\":" << rate
+                << "}" << BENCH_ENDL;
+        }
+        else
+        {
+            out << stage << "," << points << "," << plots << ","
+                << times.count() << "," << mean << "," << min << ","
+                << rate << BENCH_ENDL;
+        }
+    }
+};
+
+QVector<QPointF> MakeSamples(qint64 first, int count, int plot)
+{
+    QVector<QPointF> points(count);
+
+    for (int i = 0; i < count; i++)
+    {
+        double x = first+i;
+        double y = sin(x*1E-3*(plot+1))+0.1*sin(x*0.37);
+
+        // An occasional spike so the LOD pyramid has something to keep
+        if ((first+i)%100003 == 0)
+        {
+            y += 5;
+        }
+
+        points[i] = QPointF(x,y);
+    }
+
+    return points;
+}
+
+double TimeFrame(QOpenGL2DPlot *plot)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    plot->grabFramebuffer();
+
+    return timer.nsecsElapsed()*1E-9;
+}
+
+void WriteStage(const QOpenGL2DPlot &plot, BenchOutput &output,
+                QOpenGL2DPlot::Stage stage, const QString &name,
+                qint64 total, int plots)
+{
+    output.write(name+"_p50",total,plots,
+                 {plot.StagePercentile(stage,50)});
+    output.write(name+"_p95",total,plots,
+                 {plot.StagePercentile(stage,95)});
+}
+
+void RunConfig(const BenchConfig &config, BenchOutput &output,
+               qint64 total, int plots)
+{
+    qint64 per_plot = total/std::max<int>(plots,1);
+
+    QOpenGL2DPlot plot;
+    plot.resize(config.size);
+    plot.addPlots(plots);
+    plot.setRange(QOpenGL2DPlot::Bottom,std::max<qint64>(per_plot,1),0);
+    plot.setRange(QOpenGL2DPlot::Left,6,-2);
+
+    // Enough history for every frame below
+    plot.setStatsEnabled(true,4*config.repeat+1);
+
+    // Ingest
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int p = 0; p < plots; p++)
+    {
+        for (qint64 i = 0; i < per_plot; i += APPEND_BLOCK)
+        {
+            int count = std::min<qint64>(APPEND_BLOCK,per_plot-i);
+            plot.appendPoints(p,MakeSamples(i,count,p));
+        }
+    }
+
+    // Sample generation is part of the timing, it is the same for all
+    // plot configurations
+    output.write("ingest",total,plots,
+                 {timer.nsecsElapsed()*1E-9},per_plot*plots);
+
+    // Initialization, full upload and pyramid build
+
+    output.write("first_frame",total,plots,{TimeFrame(&plot)},
+                 per_plot*plots);
+
+    QVector<double> times;
+
+    for (int i = 0; i < config.repeat; i++)
+    {
+        times.append(TimeFrame(&plot));
+    }
+
+    output.write("frame",total,plots,times);
+
+    // Incremental upload of 1% more points per plot
+
+    times.clear();
+    qint64 appended = per_plot;
+
+    for (int i = 0; i < config.repeat; i++)
+    {
+        int count = std::max<qint64>(per_plot/100,1);
+
+        for (int p = 0; p < plots; p++)
+        {
+            plot.appendPoints(p,MakeSamples(appended,count,p));
+        }
+
+        appended += count;
+        times.append(TimeFrame(&plot));
+    }
+
+    output.write("append_frame",total,plots,times,
+                 std::max<qint64>(per_plot/100,1)*plots);
+
+    // Range change, grid and tick regeneration only
+
+    times.clear();
+
+    for (int i = 0; i < config.repeat; i++)
+    {
+        plot.setRange(QOpenGL2DPlot::Bottom,
+                      std::max<qint64>(appended,1)/(i+2.0),0);
+        plot.setTickStep(QOpenGL2DPlot::Bottom,
+                         std::max<qint64>(appended,1)/(10.0*(i+2)));
+        times.append(TimeFrame(&plot));
+    }
+
+    output.write("range_frame",total,plots,times);
+
+    // Every point as a marker
+
+    times.clear();
+
+    for (int p = 0; p < plots; p++)
+    {
+        plot.setPlotMarker(p,QOpenGL2DPlot::Circle);
+    }
+
+    for (int i = 0; i < config.repeat; i++)
+    {
+        times.append(TimeFrame(&plot));
+    }
+
+    for (int p = 0; p < plots; p++)
+    {
+        plot.setPlotMarker(p,QOpenGL2DPlot::NoMarker);
+    }
+
+    output.write("scatter_frame",total,plots,times,appended*plots);
+
+    // Point transform and grid generation on their own
+
+    WriteStage(plot,output,QOpenGL2DPlot::GeometryStage,"geometry",
+               total,plots);
+    WriteStage(plot,output,QOpenGL2DPlot::GridStage,"grid",total,plots);
+
+    // SVG export
+
+    if (total <= config.max_svg)
+    {
+        QTemporaryDir dir;
+
+        timer.restart();
+        plot.SaveSVG(dir.filePath("benchmark.svg"));
+
+        output.write("svg",total,plots,{timer.nsecsElapsed()*1E-9},
+                     appended*plots);
+    }
+}
+
+// Two blocks pushed through a producer into a sample plot, drained by
+// separate frames, have to follow the samples in the order they came.
+bool CheckProducerOrder()
+{
+    QOpenGL2DPlot plot;
+    plot.resize(64,64);
+    plot.addPlots(1);
+
+    double samples[4] = {0,1,2,3};
+    plot.setSamples(0,samples,QOpenGL2DPlot::Double,4);
+
+    QOpenGL2DPlotProducer *producer = plot.Producer(0);
+
+    producer->push(QVector<QPointF>{QPointF(4,4),QPointF(5,5)});
+    plot.grabFramebuffer();
+    producer->push(QVector<QPointF>{QPointF(6,6),QPointF(7,7)});
+    plot.grabFramebuffer();
+
+    if (plot.PlotSize(0) != 8)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < 8; i++)
+    {
+        if (plot.Point(0,i) != QPointF(i,i))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QList<qint64> ParseList(const QString &text)
+{
+    QList<qint64> list;
+
+    for (const QString &item : text.split(',',BENCH_SKIP_EMPTY))
+    {
+        list.append(qint64(item.toDouble()));
+    }
+
+    return list;
+}
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM","offscreen");
+    }
+
+    QApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("QOpenGL2DPlot benchmark");
+    parser.addHelpOption();
+
+    QCommandLineOption points_option("points",
+                "Comma separated total point counts.","list",
+                "1e3,1e4,1e5,1e6,1e7,1e8");
+    QCommandLineOption plots_option("plots",
+                "Comma separated plot counts.","list","1,10,100,1000");
+    QCommandLineOption max_total_option("max-total",
+                "Skip configurations above this many points.","n","1e8");
+    QCommandLineOption max_svg_option("max-svg",
+                "Skip SVG export above this many points.","n","1e8");
+    QCommandLineOption repeat_option("repeat",
+                "Frames per measurement.","n","10");
+    QCommandLineOption size_option("size",
+                "Widget size.","WxH","1800x1000");
+    QCommandLineOption threads_option("threads",
+                "Geometry worker threads, 0 for one per core.","n","0");
+    QCommandLineOption json_option("json",
+                "Print JSON lines instead of CSV.");
+    QCommandLineOption check_option("check",
+                "Run the consistency checks instead, exit code 1 on failure.");
+
+    parser.addOption(points_option);
+    parser.addOption(plots_option);
+    parser.addOption(max_total_option);
+    parser.addOption(max_svg_option);
+    parser.addOption(repeat_option);
+    parser.addOption(size_option);
+    parser.addOption(threads_option);
+    parser.addOption(json_option);
+    parser.addOption(check_option);
+    parser.process(a);
+
+    if (parser.isSet(check_option))
+    {
+        bool passed = CheckProducerOrder();
+
+        QTextStream(stdout) << "producer_order,"
+                            << (passed ? "pass" : "fail") << BENCH_ENDL;
+
+        return passed ? 0 : 1;
+    }
+
+    BenchConfig config;
+    config.points    = ParseList(parser.value(points_option));
+    config.max_total = parser.value(max_total_option).toDouble();
+    config.max_svg   = parser.value(max_svg_option).toDouble();
+    config.repeat    = std::max<int>(parser.value(repeat_option).toInt(),1);
+    config.json      = parser.isSet(json_option);
+
+    for (qint64 plots : ParseList(parser.value(plots_option)))
+    {
+        config.plots.append(plots);
+    }
+
+    int threads = parser.value(threads_option).toInt();
+
+    if (threads > 0)
+    {
+        QThreadPool::globalInstance()->setMaxThreadCount(threads);
+    }
+
+    QStringList size = parser.value(size_option).split('x');
+    config.size = QSize(size.value(0).toInt(),size.value(1).toInt());
+
+    BenchOutput output(config.json);
+
+    // Readback and clear cost of an empty plot
+    RunConfig(config,output,0,0);
+
+    for (qint64 points : config.points)
+    {
+        for (int plots : config.plots)
+        {
+            if (points > config.max_total || plots > points)
+            {
+                continue;
+            }
+
+            RunConfig(config,output,points,plots);
+        }
+    }
+
+    return 0;
+}